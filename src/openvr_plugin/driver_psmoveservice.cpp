@@ -14,12 +14,14 @@
 #include <string>
 
 #include <assert.h>
+#include <stddef.h>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
 
 #if defined( _WIN32 )
     #include <windows.h>
+    #include <intrin.h>
     #include <direct.h>
     #define getcwd _getcwd // suppress "deprecation" warning
 #else
@@ -56,7 +58,37 @@ static const float k_fScalePSMoveAPIToMeters = 0.01f;  // psmove driver in cm
 static const float k_fRadiansToDegrees = 180.f / 3.14159265f;
 
 static const int k_touchpadTouchMapping = (vr::EVRButtonId)31;
+static const char *k_naviGestureButtonPrefix = "navi_";
 static const float k_defaultThumbstickDeadZoneRadius = 0.1f;
+static const float k_defaultTriggerTouchThreshold = 0.1f;
+static const float k_defaultTriggerPressThreshold = 0.8f;
+static const float k_defaultTriggerHysteresis = 0.05f;
+static const float k_minResponseCurveExponent = 0.2f;
+static const float k_maxResponseCurveExponent = 5.f;
+static const float k_maxPosePredictionMilliseconds = 100.f;
+static const double k_maxSampleAgeMilliseconds = 100.0;
+static const int k_defaultDS4VelocityEstimationWindow = 8;
+static const int k_trackerPoseHeartbeatMilliseconds = 1000;
+static const int k_defaultReconnectInitialDelayMilliseconds = 250;
+static const int k_defaultReconnectMaxDelayMilliseconds = 10000;
+static const float k_defaultReconnectJitterFraction = 0.2f;
+static const int k_defaultWatchdogPollIntervalMilliseconds = 100;
+static const int k_defaultMessagePollBudgetMicroseconds = 1000;
+static const float k_defaultStationaryLinearSpeedThreshold = 0.02f; // m/s
+static const float k_defaultStationaryAngularSpeedThreshold = 0.05f; // rad/s
+static const float k_defaultStationaryPositionToleranceMillimeters = 3.f;
+static const float k_defaultStationaryAngleToleranceDegrees = 1.f;
+static const float k_defaultStationarySettleTimeMilliseconds = 500.f;
+static const float k_defaultStationaryHeartbeatMilliseconds = 250.f;
+static const int k_defaultPSMoveAxisQuantizationSteps = 0;
+static const float k_defaultPSMoveAxisDeadband = 0.005f; // just over one step of the 0-255 trigger
+static const int k_defaultDS4AxisQuantizationSteps = 0;
+static const float k_defaultDS4AxisDeadband = 0.01f;
+static const float k_maxAxisEventRateHz = 1000.f;
+static const float k_defaultJitterFilterMinCutoffHz = 1.f;
+static const float k_defaultJitterFilterPositionBeta = 15.f;
+static const float k_defaultJitterFilterRotationBeta = 6.f;
+static const float k_defaultJitterFilterDerivativeCutoffHz = 1.f;
 
 static const char *k_PSButtonNames[CPSMoveControllerLatest::k_EPSButtonID_Count] = {
     "ps",
@@ -286,6 +318,146 @@ static PSMPosef openvrMatrixExtractPSMPosef(const vr::HmdMatrix34_t &openVRTrans
 	return pose;
 }
 
+// Hamilton product a*b (i.e. apply b first, then a)
+static vr::HmdQuaternion_t hmdQuaternionMultiply(const vr::HmdQuaternion_t &a, const vr::HmdQuaternion_t &b)
+{
+	vr::HmdQuaternion_t q;
+
+	q.w = a.w*b.w - a.x*b.x - a.y*b.y - a.z*b.z;
+	q.x = a.w*b.x + a.x*b.w + a.y*b.z - a.z*b.y;
+	q.y = a.w*b.y - a.x*b.z + a.y*b.w + a.z*b.x;
+	q.z = a.w*b.z + a.x*b.y - a.y*b.x + a.z*b.w;
+
+	return q;
+}
+
+// The rotation produced by spinning at a constant angular velocity (rad/s) for dt seconds
+static vr::HmdQuaternion_t hmdQuaternionFromAngularVelocity(const double angularVelocity[3], const double dt)
+{
+	const double speed = sqrt(
+		angularVelocity[0]*angularVelocity[0] + 
+		angularVelocity[1]*angularVelocity[1] + 
+		angularVelocity[2]*angularVelocity[2]);
+	const double half_angle = 0.5 * speed * dt;
+
+	vr::HmdQuaternion_t q = { 1.0, 0.0, 0.0, 0.0 };
+	if (half_angle > 1e-9)
+	{
+		const double axis_scale = sin(half_angle) / speed;
+
+		q.w = cos(half_angle);
+		q.x = angularVelocity[0] * axis_scale;
+		q.y = angularVelocity[1] * axis_scale;
+		q.z = angularVelocity[2] * axis_scale;
+	}
+
+	return q;
+}
+
+// Extrapolate a driver pose dt seconds into the future assuming constant acceleration.
+// Velocities and accelerations are in driver (tracking) space, same as the pose.
+static void ExtrapolateDriverPose(vr::DriverPose_t &pose, const double dt)
+{
+	const double half_dt_sqr = 0.5 * dt * dt;
+	double averageAngularVelocity[3];
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		pose.vecPosition[axis] += pose.vecVelocity[axis]*dt + pose.vecAcceleration[axis]*half_dt_sqr;
+		averageAngularVelocity[axis] = pose.vecAngularVelocity[axis] + 0.5 * pose.vecAngularAcceleration[axis] * dt;
+		pose.vecVelocity[axis] += pose.vecAcceleration[axis]*dt;
+		pose.vecAngularVelocity[axis] += pose.vecAngularAcceleration[axis]*dt;
+	}
+
+	// Angular velocity is in tracking space, so the delta rotation is applied after the current orientation
+	const vr::HmdQuaternion_t deltaRotation = hmdQuaternionFromAngularVelocity(averageAngularVelocity, dt);
+	pose.qRotation = hmdQuaternionMultiply(deltaRotation, pose.qRotation);
+}
+
+//==================================================================================================
+// Reconnect Scheduler
+//==================================================================================================
+
+CPSMoveReconnectScheduler::CPSMoveReconnectScheduler()
+	: m_initialDelayMilliseconds(k_defaultReconnectInitialDelayMilliseconds)
+	, m_maxDelayMilliseconds(k_defaultReconnectMaxDelayMilliseconds)
+	, m_jitterFraction(k_defaultReconnectJitterFraction)
+	, m_nextBackoffMilliseconds(k_defaultReconnectInitialDelayMilliseconds)
+	, m_currentDelayMilliseconds(0)
+	, m_bIsRetryPending(false)
+	, m_bIsOutageInProgress(true) // Not connected yet on startup
+	, m_retryTime()
+	, m_outageStartTime(std::chrono::high_resolution_clock::now())
+	, m_randomGenerator(static_cast<unsigned int>(std::chrono::high_resolution_clock::now().time_since_epoch().count()))
+	, m_nAttemptCount(0)
+	, m_nConnectCount(0)
+	, m_lastTimeToConnectSeconds(0.0)
+	, m_maxTimeToConnectSeconds(0.0)
+{
+}
+
+void CPSMoveReconnectScheduler::SetLimits(
+	int initialDelayMilliseconds, 
+	int maxDelayMilliseconds, 
+	float jitterFraction)
+{
+	m_initialDelayMilliseconds = std::max(initialDelayMilliseconds, 1);
+	m_maxDelayMilliseconds = std::max(maxDelayMilliseconds, m_initialDelayMilliseconds);
+	m_jitterFraction = fminf(fmaxf(jitterFraction, 0.f), 1.f);
+	m_nextBackoffMilliseconds = m_initialDelayMilliseconds;
+}
+
+void CPSMoveReconnectScheduler::OnAttempt()
+{
+	m_bIsRetryPending = false;
+	++m_nAttemptCount;
+}
+
+void CPSMoveReconnectScheduler::OnAttemptFailed()
+{
+	// Spread the retry randomly over +/- the jitter fraction of the backoff
+	std::uniform_real_distribution<float> jitter(-m_jitterFraction, m_jitterFraction);
+	const float delayMilliseconds = static_cast<float>(m_nextBackoffMilliseconds) * (1.f + jitter(m_randomGenerator));
+
+	m_currentDelayMilliseconds = std::max(static_cast<int>(delayMilliseconds), 0);
+	m_retryTime = std::chrono::high_resolution_clock::now() + std::chrono::milliseconds(m_currentDelayMilliseconds);
+	m_bIsRetryPending = true;
+
+	m_nextBackoffMilliseconds = std::min(m_nextBackoffMilliseconds * 2, m_maxDelayMilliseconds);
+}
+
+void CPSMoveReconnectScheduler::OnConnected()
+{
+	if (m_bIsOutageInProgress)
+	{
+		const std::chrono::duration<double> timeToConnect = std::chrono::high_resolution_clock::now() - m_outageStartTime;
+
+		m_lastTimeToConnectSeconds = timeToConnect.count();
+		m_maxTimeToConnectSeconds = std::max(m_maxTimeToConnectSeconds, m_lastTimeToConnectSeconds);
+		m_bIsOutageInProgress = false;
+	}
+
+	++m_nConnectCount;
+	m_bIsRetryPending = false;
+	m_nextBackoffMilliseconds = m_initialDelayMilliseconds;
+}
+
+void CPSMoveReconnectScheduler::OnDisconnected()
+{
+	if (!m_bIsOutageInProgress)
+	{
+		m_outageStartTime = std::chrono::high_resolution_clock::now();
+		m_bIsOutageInProgress = true;
+	}
+
+	m_nextBackoffMilliseconds = m_initialDelayMilliseconds;
+}
+
+bool CPSMoveReconnectScheduler::IsRetryDue() const
+{
+	return m_bIsRetryPending && std::chrono::high_resolution_clock::now() >= m_retryTime;
+}
+
 //==================================================================================================
 // Watchdog Driver
 //==================================================================================================
@@ -295,7 +467,10 @@ CWatchdogDriver_PSMoveService::CWatchdogDriver_PSMoveService()
     , m_loggerMutex()
 	, m_bWasConnected(false)
 	, m_bExitSignaled({ false })
+	, m_exitSignalMutex()
+	, m_exitSignalCondition()
 	, m_pWatchdogThread(nullptr)
+	, m_pollIntervalMilliseconds(k_defaultWatchdogPollIntervalMilliseconds)
 {
 	m_strPSMoveServiceAddress= PSMOVESERVICE_DEFAULT_ADDRESS;
 	m_strServerPort= PSMOVESERVICE_DEFAULT_PORT;
@@ -336,6 +511,32 @@ vr::EVRInitError CWatchdogDriver_PSMoveService::Init( vr::IVRDriverContext *pDri
 		{
 			WatchdogLog("CWatchdogDriver_PSMoveService::Init - Using Default Server Port: %s.\n", m_strServerPort.c_str());
 		}
+
+		const int pollInterval= pSettings->GetInt32("psmoveservice", "watchdog_poll_interval_ms", &fetchError);
+		if (fetchError == vr::VRSettingsError_None)
+		{
+			m_pollIntervalMilliseconds= std::max(pollInterval, 1);
+		}
+
+		int reconnectInitialDelay= pSettings->GetInt32("psmoveservice", "reconnect_initial_delay_ms", &fetchError);
+		if (fetchError != vr::VRSettingsError_None)
+		{
+			reconnectInitialDelay= k_defaultReconnectInitialDelayMilliseconds;
+		}
+
+		int reconnectMaxDelay= pSettings->GetInt32("psmoveservice", "reconnect_max_delay_ms", &fetchError);
+		if (fetchError != vr::VRSettingsError_None)
+		{
+			reconnectMaxDelay= k_defaultReconnectMaxDelayMilliseconds;
+		}
+
+		float reconnectJitter= pSettings->GetFloat("psmoveservice", "reconnect_jitter_fraction", &fetchError);
+		if (fetchError != vr::VRSettingsError_None)
+		{
+			reconnectJitter= k_defaultReconnectJitterFraction;
+		}
+
+		m_reconnectScheduler.SetLimits(reconnectInitialDelay, reconnectMaxDelay, reconnectJitter);
 	}
 	else
 	{
@@ -360,7 +561,13 @@ void CWatchdogDriver_PSMoveService::Cleanup()
 {
 	WatchdogLog("CWatchdogDriver_PSMoveService::Cleanup - Called");
 
-	m_bExitSignaled = true;
+	// Wake the worker thread right away rather than waiting out its current sleep
+	{
+		std::lock_guard<std::mutex> guard(m_exitSignalMutex);
+		m_bExitSignaled = true;
+	}
+	m_exitSignalCondition.notify_all();
+
 	if ( m_pWatchdogThread )
 	{
 		WatchdogLog("CWatchdogDriver_PSMoveService::Cleanup - Stopping worker thread...");
@@ -384,27 +591,73 @@ void CWatchdogDriver_PSMoveService::WorkerThreadFunction()
 {
 	WatchdogLog("CWatchdogDriver_PSMoveService::WatchdogThreadFunction - Entered\n");
 
+	const std::chrono::milliseconds pollInterval(m_pollIntervalMilliseconds);
+	const std::chrono::milliseconds connectTimeout(PSM_DEFAULT_TIMEOUT);
+	std::chrono::time_point<std::chrono::high_resolution_clock> connectStartTime;
+	bool bIsConnecting= false;
+
 	while ( !m_bExitSignaled )
 	{
 		if (!PSM_GetIsInitialized())
 		{
-			if (PSM_Initialize(m_strPSMoveServiceAddress.c_str(), m_strServerPort.c_str(), PSM_DEFAULT_TIMEOUT) != PSMResult_Success)
+			// Kick off a non-blocking connection attempt
+			m_reconnectScheduler.OnAttempt();
+			if (PSM_InitializeAsync(m_strPSMoveServiceAddress.c_str(), m_strServerPort.c_str()) == PSMResult_Error)
 			{
-				// Try re-connecting in 1 second
-				std::this_thread::sleep_for( std::chrono::seconds( 1 ) );
+				m_reconnectScheduler.OnAttemptFailed();
+				WaitForExitSignal(std::chrono::milliseconds(m_reconnectScheduler.GetCurrentDelayMilliseconds()));
 				continue;
 			}
+
+			bIsConnecting= true;
+			connectStartTime= std::chrono::high_resolution_clock::now();
 		}
 
 		PSM_Update();
 
+		if (bIsConnecting)
+		{
+			if (PSM_GetIsConnected())
+			{
+				bIsConnecting= false;
+				m_bWasConnected= true;
+				m_reconnectScheduler.OnConnected();
+				WatchdogLog("CWatchdogDriver_PSMoveService::WatchdogThreadFunction - Connected after %llu attempt(s).\n", 
+					m_reconnectScheduler.GetAttemptCount());
+			}
+			else if (PSM_HasConnectionStatusChanged() ||
+					 std::chrono::high_resolution_clock::now() - connectStartTime > connectTimeout)
+			{
+				// Connection refused or timed out, back off before trying again
+				bIsConnecting= false;
+				PSM_Shutdown();
+				m_reconnectScheduler.OnAttemptFailed();
+				WaitForExitSignal(std::chrono::milliseconds(m_reconnectScheduler.GetCurrentDelayMilliseconds()));
+				continue;
+			}
+		}
+		else if (!PSM_GetIsConnected())
+		{
+			WatchdogLog("CWatchdogDriver_PSMoveService::WatchdogThreadFunction - Lost connection to PSMoveService.\n");
+			m_bWasConnected= false;
+			PSM_Shutdown();
+			m_reconnectScheduler.OnDisconnected();
+			m_reconnectScheduler.OnAttemptFailed();
+			WaitForExitSignal(std::chrono::milliseconds(m_reconnectScheduler.GetCurrentDelayMilliseconds()));
+			continue;
+		}
+
 		if (PSM_WasSystemButtonPressed())
 		{
 			WatchdogLog("CWatchdogDriver_PSMoveService::WatchdogThreadFunction - System button pressed. Initiating wake up.\n");
 			vr::VRWatchdogHost()->WatchdogWakeUp();
 		}
 
-		std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+		// There's no event driven wake up: the client API doesn't expose its socket to wait on,
+		// so the connection has to be polled. The 100ms default keeps idle wake ups rare,
+		// lower watchdog_poll_interval_ms trades more wake ups for a snappier system button.
+		// (Waiting on the exit signal only lets Cleanup() stop the thread without waiting out the poll)
+		WaitForExitSignal(pollInterval);
 	}
 
 	PSM_Shutdown();
@@ -412,6 +665,13 @@ void CWatchdogDriver_PSMoveService::WorkerThreadFunction()
 	vr::VRDriverLog()->Log("CWatchdogDriver_PSMoveService::WatchdogThreadFunction - Exited\n");
 }
 
+bool CWatchdogDriver_PSMoveService::WaitForExitSignal(const std::chrono::milliseconds &timeout)
+{
+	std::unique_lock<std::mutex> lock(m_exitSignalMutex);
+
+	return m_exitSignalCondition.wait_for(lock, timeout, [this]() { return m_bExitSignaled.load(); });
+}
+
 void CWatchdogDriver_PSMoveService::WatchdogLogVarArgs( const char *pMsgFormat, va_list args )
 {
     char buf[1024];
@@ -440,927 +700,2745 @@ void CWatchdogDriver_PSMoveService::WatchdogLog( const char *pMsgFormat, ... )
 }
 
 //==================================================================================================
-// Server Provider
+// Message Dispatcher
 //==================================================================================================
 
-CServerDriver_PSMoveService::CServerDriver_PSMoveService()
-    : m_bLaunchedPSMoveMonitor(false)
-	, m_bInitialized(false)
+static const char *k_eventTypeNames[] = {
+	"connected_to_service",
+	"failed_to_connect_to_service",
+	"disconnected_from_service",
+	"opaque_service_event",
+	"controller_list_updated",
+	"tracker_list_updated",
+	"hmd_list_updated",
+	"system_button_pressed"
+};
+
+static const char *k_responseTypeNames[] = {
+	"empty",
+	"controller_list",
+	"tracker_list",
+	"hmd_list",
+	"service_version"
+};
+
+CPSMoveMessageDispatcher::CPSMoveMessageDispatcher()
+	: m_nUnknownMessageCount(0)
 {
-	m_strPSMoveServiceAddress= PSMOVESERVICE_DEFAULT_ADDRESS;
-	m_strServerPort= PSMOVESERVICE_DEFAULT_PORT;
+	memset(m_eventHandlers, 0, sizeof(m_eventHandlers));
+	memset(m_responseHandlers, 0, sizeof(m_responseHandlers));
 }
 
-CServerDriver_PSMoveService::~CServerDriver_PSMoveService()
+bool CPSMoveMessageDispatcher::RegisterEventHandler(
+	PSMEventMessage::eEventType eventType, 
+	MessageHandler handler, 
+	void *userdata)
 {
-	// 10/10/2015 benj:  vrserver is exiting without calling Cleanup() to balance Init()
-	// causing std::thread to call std::terminate
-	Cleanup();
+	const int index = static_cast<int>(eventType);
+	if (index < 0 || index >= k_maxEventTypes)
+		return false;
+
+	m_eventHandlers[index].handler = handler;
+	m_eventHandlers[index].userdata = userdata;
+	return true;
 }
 
-vr::EVRInitError CServerDriver_PSMoveService::Init(
-    vr::IVRDriverContext *pDriverContext )
+bool CPSMoveMessageDispatcher::RegisterResponseHandler(
+	PSMResponseMessage::eResponsePayloadType payloadType, 
+	MessageHandler handler, 
+	void *userdata)
 {
-	VR_INIT_SERVER_DRIVER_CONTEXT( pDriverContext );
+	const int index = static_cast<int>(payloadType);
+	if (index < 0 || index >= k_maxResponseTypes)
+		return false;
 
-    vr::EVRInitError initError = vr::VRInitError_None;
+	m_responseHandlers[index].handler = handler;
+	m_responseHandlers[index].userdata = userdata;
+	return true;
+}
 
-	InitDriverLog(vr::VRDriverLog());
-	DriverLog("CServerDriver_PSMoveService::Init - called.\n");
+void CPSMoveMessageDispatcher::InvokeHandler(
+	HandlerEntry &entry, 
+	const PSMMessage *message)
+{
+	const std::chrono::time_point<std::chrono::high_resolution_clock> startTime = std::chrono::high_resolution_clock::now();
 
-	if (!m_bInitialized)
+	if (entry.handler != nullptr)
 	{
-		vr::IVRSettings *pSettings = vr::VRSettings();
-		if (pSettings != nullptr) 
+		entry.handler(message, entry.userdata);
+	}
+
+	const std::chrono::duration<double> handlingTime = std::chrono::high_resolution_clock::now() - startTime;
+
+	++entry.invocationCount;
+	entry.totalSeconds += handlingTime.count();
+}
+
+void CPSMoveMessageDispatcher::Dispatch(const PSMMessage *message)
+{
+	switch (message->payload_type)
+	{
+	case PSMMessage::_messagePayloadType_Event:
 		{
-			char buf[256];
-			vr::EVRSettingsError fetchError;
+			const int index = static_cast<int>(message->event_data.event_type);
 
-			pSettings->GetString("psmove_settings", "psmove_filter_hmd_serial", buf, sizeof(buf), &fetchError);
-			if (fetchError == vr::VRSettingsError_None)
+			if (index >= 0 && index < k_maxEventTypes)
 			{
-				m_strPSMoveHMDSerialNo = buf;
-				std::transform(m_strPSMoveHMDSerialNo.begin(), m_strPSMoveHMDSerialNo.end(), m_strPSMoveHMDSerialNo.begin(), ::toupper);
+				InvokeHandler(m_eventHandlers[index], message);
 			}
-
-			pSettings->GetString("psmoveservice", "server_address", buf, sizeof(buf), &fetchError);
-			if (fetchError == vr::VRSettingsError_None)
+			else
 			{
-				m_strPSMoveServiceAddress= buf;
-				DriverLog("CServerDriver_PSMoveService::Init - Overridden Server Address: %s.\n", m_strPSMoveServiceAddress.c_str());
+				++m_nUnknownMessageCount;
 			}
-			else
+		} break;
+	case PSMMessage::_messagePayloadType_Response:
+		{
+			const int index = static_cast<int>(message->response_data.payload_type);
+
+			const bool bIsKnownType = index >= 0 && index < k_maxResponseTypes;
+
+			if (!bIsKnownType || m_responseHandlers[index].handler == nullptr)
 			{
-				DriverLog("CServerDriver_PSMoveService::Init - Using Default Server Address: %s.\n", m_strPSMoveServiceAddress.c_str());
+				DriverLog("NotifyClientPSMoveResponse - Unhandled response (request id %d).\n", message->response_data.request_id);
 			}
 
-			pSettings->GetString("psmoveservice", "server_port", buf, sizeof(buf), &fetchError);
-			if (fetchError == vr::VRSettingsError_None)
+			if (bIsKnownType)
 			{
-				m_strServerPort= buf;
-				DriverLog("CServerDriver_PSMoveService::Init - Overridden Server Port: %s.\n", m_strServerPort.c_str());
+				InvokeHandler(m_responseHandlers[index], message);
 			}
 			else
 			{
-				DriverLog("CServerDriver_PSMoveService::Init - Using Default Server Port: %s.\n", m_strServerPort.c_str());
+				++m_nUnknownMessageCount;
 			}
-		}
-		else
-		{
-			DriverLog("CServerDriver_PSMoveService::Init - NULL settings!.\n");
-		}
+		} break;
+	default:
+		++m_nUnknownMessageCount;
+	}
+}
 
-		DriverLog("CServerDriver_PSMoveService::Init - Initializing.\n");
+void CPSMoveMessageDispatcher::GetStats(
+	char *pchResponseBuffer, 
+	uint32_t unResponseBufferSize) const
+{
+	// One "<type>=<count>/<total us>" entry for every message type seen so far
+	size_t offset = 0;
+	pchResponseBuffer[0] = '\0';
 
-		// By default, assume the psmove and openvr tracking spaces are the same
-		m_worldFromDriverPose= *k_psm_pose_identity;
+	for (int index = 0; index < k_maxEventTypes + k_maxResponseTypes && offset < unResponseBufferSize; ++index)
+	{
+		const bool bIsEvent = index < k_maxEventTypes;
+		const int typeIndex = bIsEvent ? index : index - k_maxEventTypes;
+		const HandlerEntry &entry = bIsEvent ? m_eventHandlers[typeIndex] : m_responseHandlers[typeIndex];
+
+		if (entry.invocationCount == 0)
+			continue;
+
+		const int nameCount = bIsEvent 
+			? static_cast<int>(sizeof(k_eventTypeNames) / sizeof(k_eventTypeNames[0])) 
+			: static_cast<int>(sizeof(k_responseTypeNames) / sizeof(k_responseTypeNames[0]));
+		const char *name = (typeIndex < nameCount) ? (bIsEvent ? k_eventTypeNames[typeIndex] : k_responseTypeNames[typeIndex]) : "unknown";
+
+		const int written = snprintf(pchResponseBuffer + offset, unResponseBufferSize - offset,
+			"%s%s:%s=%llu/%.0fus", 
+			(offset > 0) ? " " : "",
+			bIsEvent ? "event" : "response",
+			name,
+			entry.invocationCount,
+			entry.totalSeconds * 1000000.0);
+		if (written < 0)
+			break;
 
-		// Note that reconnection is a non-blocking async request.
-		// Returning true means we we're able to start trying to connect,
-		// not that we are successfully connected yet.
-		if (!ReconnectToPSMoveService())
+		offset += static_cast<size_t>(written);
+	}
+
+	if (offset < unResponseBufferSize)
+	{
+		snprintf(pchResponseBuffer + offset, unResponseBufferSize - offset, 
+			"%sunknown=%llu", (offset > 0) ? " " : "", m_nUnknownMessageCount);
+	}
+
+	pchResponseBuffer[unResponseBufferSize - 1] = '\0';
+}
+
+//==================================================================================================
+// Tracked Device Registry
+//==================================================================================================
+
+// FNV-1a
+static uint32_t HashRegistryKey(const char *pchKey)
+{
+	uint32_t hash = 2166136261u;
+
+	for (const char *pch = pchKey; *pch != '\0'; ++pch)
+	{
+		hash ^= static_cast<uint8_t>(*pch);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+CPSMoveTrackedDeviceRegistry::CPSMoveTrackedDeviceRegistry()
+{
+	Clear();
+}
+
+void CPSMoveTrackedDeviceRegistry::Clear()
+{
+	memset(m_controllersById, 0, sizeof(m_controllersById));
+	memset(m_trackersById, 0, sizeof(m_trackersById));
+	memset(m_serialTable, 0, sizeof(m_serialTable));
+	memset(m_identifierTable, 0, sizeof(m_identifierTable));
+}
+
+bool CPSMoveTrackedDeviceRegistry::NormalizeKey(
+	const char *pchKey, 
+	char *pchOutKey, 
+	size_t outKeySize)
+{
+	size_t length = 0;
+
+	for (; pchKey[length] != '\0'; ++length)
+	{
+		if (length + 1 >= outKeySize)
 		{
-			initError = vr::VRInitError_Driver_Failed;
+			pchOutKey[length] = '\0';
+			return false;
 		}
 
-		m_bInitialized = true;
+		pchOutKey[length] = static_cast<char>(::toupper(static_cast<unsigned char>(pchKey[length])));
 	}
-	else
+
+	pchOutKey[length] = '\0';
+	return true;
+}
+
+bool CPSMoveTrackedDeviceRegistry::InsertKey(
+	HashEntry *table, 
+	const char *pchKey, 
+	CPSMoveTrackedDeviceLatest *pDevice)
+{
+	char key[k_maxKeyLength];
+	if (!NormalizeKey(pchKey, key, sizeof(key)))
+		return false;
+
+	// Linear probing. Entries are never removed, so an empty slot ends the probe sequence.
+	const uint32_t start = HashRegistryKey(key) & (k_hashTableSize - 1);
+	for (int probe = 0; probe < k_hashTableSize; ++probe)
 	{
-		DriverLog("CServerDriver_PSMoveService::Init - Already Initialized. Ignoring.\n");
+		HashEntry &entry = table[(start + probe) & (k_hashTableSize - 1)];
+
+		if (entry.pDevice == nullptr || strcmp(entry.key, key) == 0)
+		{
+			memcpy(entry.key, key, sizeof(key));
+			entry.pDevice = pDevice;
+			return true;
+		}
 	}
 
-    return initError;
+	return false;
 }
 
-bool CServerDriver_PSMoveService::ReconnectToPSMoveService()
+CPSMoveTrackedDeviceLatest *CPSMoveTrackedDeviceRegistry::LookupKey(
+	const HashEntry *table, 
+	const char *pchKey)
 {
-	DriverLog("CServerDriver_PSMoveService::ReconnectToPSMoveService - called.\n");
+	char key[k_maxKeyLength];
+	if (!NormalizeKey(pchKey, key, sizeof(key)))
+		return nullptr;
 
-    if (PSM_GetIsInitialized())
-    {
-		DriverLog("CServerDriver_PSMoveService::ReconnectToPSMoveService - Existing PSMoveService connection active. Shutting down...\n");
-        PSM_Shutdown();
-		DriverLog("CServerDriver_PSMoveService::ReconnectToPSMoveService - Existing PSMoveService connection stopped.\n");
-    }
-	else
+	const uint32_t start = HashRegistryKey(key) & (k_hashTableSize - 1);
+	for (int probe = 0; probe < k_hashTableSize; ++probe)
 	{
-		DriverLog("CServerDriver_PSMoveService::ReconnectToPSMoveService - Existing PSMoveService connection NOT active.\n");
+		const HashEntry &entry = table[(start + probe) & (k_hashTableSize - 1)];
+
+		if (entry.pDevice == nullptr)
+			break;
+
+		if (strcmp(entry.key, key) == 0)
+			return entry.pDevice;
 	}
 
-	DriverLog("CServerDriver_PSMoveService::ReconnectToPSMoveService - Starting PSMoveService connection...\n");
-    bool bSuccess= PSM_InitializeAsync(m_strPSMoveServiceAddress.c_str(), m_strServerPort.c_str()) != PSMResult_Error;
+	return nullptr;
+}
+
+bool CPSMoveTrackedDeviceRegistry::AddController(CPSMoveControllerLatest *pController)
+{
+	const int controllerId = pController->getPSMControllerId();
+	bool bSuccess = controllerId >= 0 && controllerId < PSMOVESERVICE_MAX_CONTROLLER_COUNT;
 
 	if (bSuccess)
 	{
-		DriverLog("CServerDriver_PSMoveService::ReconnectToPSMoveService - Successfully requested connection\n");
+		BindControllerId(pController, controllerId);
 	}
-	else
+
+	bSuccess &= InsertKey(m_serialTable, pController->getPSMControllerSerialNo().c_str(), pController);
+	bSuccess &= InsertKey(m_identifierTable, pController->GetSteamVRIdentifier(), pController);
+
+	if (!bSuccess)
 	{
-		DriverLog("CServerDriver_PSMoveService::ReconnectToPSMoveService - Failed to request connection!\n");
+		DriverLog("CPSMoveTrackedDeviceRegistry::AddController - Failed to fully index controller %s\n", pController->GetSteamVRIdentifier());
 	}
 
 	return bSuccess;
 }
 
-void CServerDriver_PSMoveService::Cleanup()
+bool CPSMoveTrackedDeviceRegistry::AddTracker(CPSMoveTrackerLatest *pTracker)
 {
-	if (m_bInitialized)
+	const int trackerId = pTracker->GetTrackerId();
+	bool bSuccess = trackerId >= 0 && trackerId < PSMOVESERVICE_MAX_TRACKER_COUNT;
+
+	if (bSuccess)
 	{
-		DriverLog("CServerDriver_PSMoveService::Cleanup - Shutting down connection...\n");
-		PSM_Shutdown();
-		DriverLog("CServerDriver_PSMoveService::Cleanup - Shutdown complete\n");
+		m_trackersById[trackerId] = pTracker;
+	}
 
-		m_bInitialized = false;
+	bSuccess &= InsertKey(m_identifierTable, pTracker->GetSteamVRIdentifier(), pTracker);
+
+	if (!bSuccess)
+	{
+		DriverLog("CPSMoveTrackedDeviceRegistry::AddTracker - Failed to fully index tracker %s\n", pTracker->GetSteamVRIdentifier());
 	}
+
+	return bSuccess;
 }
 
-const char * const *CServerDriver_PSMoveService::GetInterfaceVersions()
+void CPSMoveTrackedDeviceRegistry::BindControllerId(
+	CPSMoveControllerLatest *pController, 
+	PSMControllerID controllerId)
 {
-    return vr::k_InterfaceVersions;
+	if (controllerId >= 0 && controllerId < PSMOVESERVICE_MAX_CONTROLLER_COUNT)
+	{
+		m_controllersById[controllerId] = pController;
+	}
 }
 
-vr::ITrackedDeviceServerDriver * CServerDriver_PSMoveService::FindTrackedDeviceDriver(
-    const char * pchId)
+void CPSMoveTrackedDeviceRegistry::UnbindControllerId(
+	PSMControllerID controllerId, 
+	const CPSMoveControllerLatest *pController)
 {
-    for (auto it = m_vecTrackedDevices.begin(); it != m_vecTrackedDevices.end(); ++it)
-    {
-        if ( 0 == strcmp( ( *it )->GetSteamVRIdentifier(), pchId ) )
-        {
-            return *it;
-        }
-    }
+	// Another controller may already have been re-bound to this id
+	if (controllerId >= 0 && controllerId < PSMOVESERVICE_MAX_CONTROLLER_COUNT &&
+		m_controllersById[controllerId] == pController)
+	{
+		m_controllersById[controllerId] = nullptr;
+	}
+}
 
-    return nullptr;
+CPSMoveControllerLatest *CPSMoveTrackedDeviceRegistry::FindControllerById(PSMControllerID controllerId) const
+{
+	return (controllerId >= 0 && controllerId < PSMOVESERVICE_MAX_CONTROLLER_COUNT) ? m_controllersById[controllerId] : nullptr;
 }
 
-void CServerDriver_PSMoveService::RunFrame()
+CPSMoveTrackerLatest *CPSMoveTrackedDeviceRegistry::FindTrackerById(PSMTrackerID trackerId) const
 {
-    // Update any controllers that are currently listening
-    PSM_UpdateNoPollMessages();
+	return (trackerId >= 0 && trackerId < PSMOVESERVICE_MAX_TRACKER_COUNT) ? m_trackersById[trackerId] : nullptr;
+}
 
-    // Poll events queued up by the call to PSM_UpdateNoPollMessages()
-    PSMMessage mesg;
-    while (PSM_PollNextMessage(&mesg, sizeof(PSMMessage)) == PSMResult_Success)
-    {
-        switch (mesg.payload_type)
-        {
-        case PSMMessage::_messagePayloadType_Response:
-            HandleClientPSMoveResponse(&mesg);
-            break;
-        case PSMMessage::_messagePayloadType_Event:
-            HandleClientPSMoveEvent(&mesg);
-            break;
-        }
-    }
+CPSMoveControllerLatest *CPSMoveTrackedDeviceRegistry::FindControllerBySerial(const char *pchSerial) const
+{
+	// Only controllers go in the serial table
+	return static_cast<CPSMoveControllerLatest *>(LookupKey(m_serialTable, pchSerial));
+}
 
-    // Update all active tracked devices
-    for (auto it = m_vecTrackedDevices.begin(); it != m_vecTrackedDevices.end(); ++it)
-    {
-        CPSMoveTrackedDeviceLatest *pTrackedDevice = *it;
+CPSMoveTrackedDeviceLatest *CPSMoveTrackedDeviceRegistry::FindDeviceBySteamVRIdentifier(const char *pchIdentifier) const
+{
+	return LookupKey(m_identifierTable, pchIdentifier);
+}
 
-        switch (pTrackedDevice->GetTrackedDeviceClass())
-        {
-        case vr::TrackedDeviceClass_Controller:
-            {
-                CPSMoveControllerLatest *pController = static_cast<CPSMoveControllerLatest *>(pTrackedDevice);
+//==================================================================================================
+// Server Provider
+//==================================================================================================
 
-                pController->Update();
-            } break;
-        case vr::TrackedDeviceClass_TrackingReference:
-            {
-                CPSMoveTrackerLatest *pTracker = static_cast<CPSMoveTrackerLatest *>(pTrackedDevice);
+CServerDriver_PSMoveService::CServerDriver_PSMoveService()
+    : m_bLaunchedPSMoveMonitor(false)
+	, m_bInitialized(false)
+	, m_bUsePosePublisherThread(false)
+	, m_posePublisherPollIntervalMicroseconds(1000)
+	, m_bPosePublisherExitSignaled({ false })
+	, m_pPosePublisherThread(nullptr)
+	, m_serviceVersionState(k_EServiceVersionState_Pending)
+	, m_bShutdownRequested({ false })
+	, m_bHasPendingControllerList(false)
+	, m_bHasPendingTrackerList(false)
+	, m_messagePollBudgetMicroseconds(k_defaultMessagePollBudgetMicroseconds)
+	, m_bControllerListRefreshQueued(false)
+	, m_bTrackerListRefreshQueued(false)
+	, m_nMessagePollFrameCount(0)
+	, m_nMessagesHandledCount(0)
+	, m_nMessageBudgetExceededCount(0)
+	, m_nCoalescedListRefreshCount(0)
+	, m_nMaxMessagesPerFrame(0)
+	, m_nDeviceUpdateFrameCount(0)
+	, m_deviceUpdateTotalSeconds(0.0)
+	, m_deviceUpdateMaxSeconds(0.0)
+	, m_nPublishedPoseCount(0)
+	, m_posePublishTotalSeconds(0.0)
+	, m_serviceDisconnectTime()
+	, m_bAwaitingFirstPoseAfterResume(false)
+	, m_lastResumeTimeToFirstPoseSeconds(0.0)
+{
+	m_strPSMoveServiceAddress= PSMOVESERVICE_DEFAULT_ADDRESS;
+	m_strServerPort= PSMOVESERVICE_DEFAULT_PORT;
 
-                pTracker->Update();
-            } break;
-        default:
-            assert(0 && "unreachable");
-        }
-    }
+	RegisterMessageHandlers();
 }
 
-bool CServerDriver_PSMoveService::ShouldBlockStandbyMode()
+CServerDriver_PSMoveService::~CServerDriver_PSMoveService()
 {
-    return false;
+	// 10/10/2015 benj:  vrserver is exiting without calling Cleanup() to balance Init()
+	// causing std::thread to call std::terminate
+	Cleanup();
 }
 
-void CServerDriver_PSMoveService::EnterStandby()
+vr::EVRInitError CServerDriver_PSMoveService::Init(
+    vr::IVRDriverContext *pDriverContext )
+{
+	VR_INIT_SERVER_DRIVER_CONTEXT( pDriverContext );
+
+    vr::EVRInitError initError = vr::VRInitError_None;
+
+	InitDriverLog(vr::VRDriverLog());
+	DriverLog("CServerDriver_PSMoveService::Init - called.\n");
+
+	if (!m_bInitialized)
+	{
+		vr::IVRSettings *pSettings = vr::VRSettings();
+		if (pSettings != nullptr) 
+		{
+			char buf[256];
+			vr::EVRSettingsError fetchError;
+
+			pSettings->GetString("psmove_settings", "psmove_filter_hmd_serial", buf, sizeof(buf), &fetchError);
+			if (fetchError == vr::VRSettingsError_None)
+			{
+				m_strPSMoveHMDSerialNo = buf;
+				std::transform(m_strPSMoveHMDSerialNo.begin(), m_strPSMoveHMDSerialNo.end(), m_strPSMoveHMDSerialNo.begin(), ::toupper);
+			}
+
+			pSettings->GetString("psmoveservice", "server_address", buf, sizeof(buf), &fetchError);
+			if (fetchError == vr::VRSettingsError_None)
+			{
+				m_strPSMoveServiceAddress= buf;
+				DriverLog("CServerDriver_PSMoveService::Init - Overridden Server Address: %s.\n", m_strPSMoveServiceAddress.c_str());
+			}
+			else
+			{
+				DriverLog("CServerDriver_PSMoveService::Init - Using Default Server Address: %s.\n", m_strPSMoveServiceAddress.c_str());
+			}
+
+			pSettings->GetString("psmoveservice", "server_port", buf, sizeof(buf), &fetchError);
+			if (fetchError == vr::VRSettingsError_None)
+			{
+				m_strServerPort= buf;
+				DriverLog("CServerDriver_PSMoveService::Init - Overridden Server Port: %s.\n", m_strServerPort.c_str());
+			}
+			else
+			{
+				DriverLog("CServerDriver_PSMoveService::Init - Using Default Server Port: %s.\n", m_strServerPort.c_str());
+			}
+
+			const bool bUsePosePublisherThread= pSettings->GetBool("psmoveservice", "use_pose_publisher_thread", &fetchError);
+			if (fetchError == vr::VRSettingsError_None)
+			{
+				m_bUsePosePublisherThread= bUsePosePublisherThread;
+			}
+
+			const int posePublisherPollInterval= pSettings->GetInt32("psmoveservice", "pose_publisher_poll_interval_us", &fetchError);
+			if (fetchError == vr::VRSettingsError_None)
+			{
+				m_posePublisherPollIntervalMicroseconds= std::max(posePublisherPollInterval, 100);
+			}
+
+			const int messagePollBudget= pSettings->GetInt32("psmoveservice", "message_poll_budget_us", &fetchError);
+			if (fetchError == vr::VRSettingsError_None)
+			{
+				m_messagePollBudgetMicroseconds= std::max(messagePollBudget, 0);
+			}
+
+			int reconnectInitialDelay= pSettings->GetInt32("psmoveservice", "reconnect_initial_delay_ms", &fetchError);
+			if (fetchError != vr::VRSettingsError_None)
+			{
+				reconnectInitialDelay= k_defaultReconnectInitialDelayMilliseconds;
+			}
+
+			int reconnectMaxDelay= pSettings->GetInt32("psmoveservice", "reconnect_max_delay_ms", &fetchError);
+			if (fetchError != vr::VRSettingsError_None)
+			{
+				reconnectMaxDelay= k_defaultReconnectMaxDelayMilliseconds;
+			}
+
+			float reconnectJitter= pSettings->GetFloat("psmoveservice", "reconnect_jitter_fraction", &fetchError);
+			if (fetchError != vr::VRSettingsError_None)
+			{
+				reconnectJitter= k_defaultReconnectJitterFraction;
+			}
+
+			m_reconnectScheduler.SetLimits(reconnectInitialDelay, reconnectMaxDelay, reconnectJitter);
+		}
+		else
+		{
+			DriverLog("CServerDriver_PSMoveService::Init - NULL settings!.\n");
+		}
+
+		DriverLog("CServerDriver_PSMoveService::Init - Initializing.\n");
+
+		// By default, assume the psmove and openvr tracking spaces are the same
+		m_worldFromDriverPose= *k_psm_pose_identity;
+
+		// Note that reconnection is a non-blocking async request.
+		// Returning true means we we're able to start trying to connect,
+		// not that we are successfully connected yet.
+		m_reconnectScheduler.OnAttempt();
+		if (!ReconnectToPSMoveService())
+		{
+			initError = vr::VRInitError_Driver_Failed;
+		}
+
+		if (m_bUsePosePublisherThread)
+		{
+			StartPosePublisherThread();
+		}
+
+		m_bInitialized = true;
+	}
+	else
+	{
+		DriverLog("CServerDriver_PSMoveService::Init - Already Initialized. Ignoring.\n");
+	}
+
+    return initError;
+}
+
+void CServerDriver_PSMoveService::ScheduleReconnectToPSMoveService()
 {
+	m_reconnectScheduler.OnAttemptFailed();
+
+	DriverLog("CServerDriver_PSMoveService::ScheduleReconnectToPSMoveService - Retrying in %d ms (attempt %llu)\n",
+		m_reconnectScheduler.GetCurrentDelayMilliseconds(), m_reconnectScheduler.GetAttemptCount() + 1);
 }
 
-void CServerDriver_PSMoveService::LeaveStandby()
+void CServerDriver_PSMoveService::GetProviderStats(
+	const std::string &strSection,
+	char *pchResponseBuffer, 
+	uint32_t unResponseBufferSize)
+{
+	typedef void (CServerDriver_PSMoveService::*StatsFunction)(char *pchResponseBuffer, uint32_t unResponseBufferSize);
+	struct StatsSection
+	{
+		const char *name;
+		StatsFunction function;
+	};
+	static const StatsSection k_statsSections[] = {
+		{"connection", &CServerDriver_PSMoveService::GetConnectionStats},
+		{"message", &CServerDriver_PSMoveService::GetMessageStats},
+		{"dispatch", &CServerDriver_PSMoveService::GetDispatchStats},
+		{"device_update", &CServerDriver_PSMoveService::GetDeviceUpdateStats},
+		{"pose_publish", &CServerDriver_PSMoveService::GetPosePublishStats},
+	};
+	static const int k_statsSectionCount = sizeof(k_statsSections) / sizeof(k_statsSections[0]);
+
+	std::lock_guard<std::recursive_mutex> guard(m_psmClientMutex);
+
+	pchResponseBuffer[0] = '\0';
+
+	// One "name: stats" line per section, for as many as fit in the response buffer
+	uint32_t offset = 0;
+	for (int sectionIndex = 0; sectionIndex < k_statsSectionCount && offset + 1 < unResponseBufferSize; ++sectionIndex)
+	{
+		const StatsSection &section = k_statsSections[sectionIndex];
+
+		if (!strSection.empty() && strSection != section.name)
+			continue;
+
+		const int prefixLength = snprintf(pchResponseBuffer + offset, unResponseBufferSize - offset, 
+			"%s%s: ", (offset > 0) ? "\n" : "", section.name);
+		if (prefixLength < 0 || offset + prefixLength + 1 >= unResponseBufferSize)
+			break;
+		offset += prefixLength;
+
+		(this->*section.function)(pchResponseBuffer + offset, unResponseBufferSize - offset);
+		offset += static_cast<uint32_t>(strlen(pchResponseBuffer + offset));
+	}
+
+	if (offset == 0 && !strSection.empty())
+	{
+		snprintf(pchResponseBuffer, unResponseBufferSize, "unknown section: %s", strSection.c_str());
+	}
+
+	pchResponseBuffer[unResponseBufferSize - 1] = '\0';
+}
+
+void CServerDriver_PSMoveService::GetConnectionStats(
+	char *pchResponseBuffer, 
+	uint32_t unResponseBufferSize)
 {
+	std::lock_guard<std::recursive_mutex> guard(m_psmClientMutex);
+
+	snprintf(pchResponseBuffer, unResponseBufferSize,
+		"connected=%d attempts=%llu connects=%llu retry_delay_ms=%d last_time_to_connect_ms=%.0f max_time_to_connect_ms=%.0f last_resume_first_pose_ms=%.0f",
+		PSM_GetIsConnected() ? 1 : 0,
+		m_reconnectScheduler.GetAttemptCount(),
+		m_reconnectScheduler.GetConnectCount(),
+		m_reconnectScheduler.IsRetryPending() ? m_reconnectScheduler.GetCurrentDelayMilliseconds() : 0,
+		m_reconnectScheduler.GetLastTimeToConnectSeconds() * 1000.0,
+		m_reconnectScheduler.GetMaxTimeToConnectSeconds() * 1000.0,
+		m_lastResumeTimeToFirstPoseSeconds * 1000.0);
+	pchResponseBuffer[unResponseBufferSize - 1] = '\0';
 }
 
-// -- Event Handling -----
-void CServerDriver_PSMoveService::HandleClientPSMoveEvent(
-    const PSMMessage *message)
+bool CServerDriver_PSMoveService::ReconnectToPSMoveService()
 {
-    switch (message->event_data.event_type)
-    {
-    // Client Events
-    case PSMEventMessage::PSMEvent_connectedToService:
-        HandleConnectedToPSMoveService();
-        break;
-    case PSMEventMessage::PSMEvent_failedToConnectToService:
-        HandleFailedToConnectToPSMoveService();
-        break;
-    case PSMEventMessage::PSMEvent_disconnectedFromService:
-        HandleDisconnectedFromPSMoveService();
-        break;
+	DriverLog("CServerDriver_PSMoveService::ReconnectToPSMoveService - called.\n");
 
-    // Service Events
-    case PSMEventMessage::PSMEvent_opaqueServiceEvent: 
-        // We don't care about any opaque service events
-        break;
-    case PSMEventMessage::PSMEvent_controllerListUpdated:
-        HandleControllerListChanged();
-        break;
-    case PSMEventMessage::PSMEvent_trackerListUpdated:
-        HandleTrackerListChanged();
-        break;
-    case PSMEventMessage::PSMEvent_hmdListUpdated:
-        // don't care
-        break;
-	case PSMEventMessage::PSMEvent_systemButtonPressed:
-        // don't care
-        break;
-    //###HipsterSloth $TODO - Need a notification for when a tracker pose changes
+    if (PSM_GetIsInitialized())
+    {
+		DriverLog("CServerDriver_PSMoveService::ReconnectToPSMoveService - Existing PSMoveService connection active. Shutting down...\n");
+        PSM_Shutdown();
+		DriverLog("CServerDriver_PSMoveService::ReconnectToPSMoveService - Existing PSMoveService connection stopped.\n");
     }
+	else
+	{
+		DriverLog("CServerDriver_PSMoveService::ReconnectToPSMoveService - Existing PSMoveService connection NOT active.\n");
+	}
+
+	DriverLog("CServerDriver_PSMoveService::ReconnectToPSMoveService - Starting PSMoveService connection...\n");
+    bool bSuccess= PSM_InitializeAsync(m_strPSMoveServiceAddress.c_str(), m_strServerPort.c_str()) != PSMResult_Error;
+
+	if (bSuccess)
+	{
+		DriverLog("CServerDriver_PSMoveService::ReconnectToPSMoveService - Successfully requested connection\n");
+	}
+	else
+	{
+		DriverLog("CServerDriver_PSMoveService::ReconnectToPSMoveService - Failed to request connection!\n");
+	}
+
+	return bSuccess;
 }
 
-void CServerDriver_PSMoveService::HandleConnectedToPSMoveService()
+void CServerDriver_PSMoveService::Cleanup()
 {
-	DriverLog("CServerDriver_PSMoveService::HandleConnectedToPSMoveService - Request controller and tracker lists\n");
+	if (m_bInitialized)
+	{
+		StopPosePublisherThread();
 
-	PSMRequestID request_id;
-	PSM_GetServiceVersionStringAsync(&request_id);
-	PSM_RegisterCallback(request_id, CServerDriver_PSMoveService::HandleServiceVersionResponse, this);
+		DriverLog("CServerDriver_PSMoveService::Cleanup - Shutting down connection...\n");
+		PSM_Shutdown();
+		DriverLog("CServerDriver_PSMoveService::Cleanup - Shutdown complete\n");
+
+		m_bInitialized = false;
+	}
 }
 
-void CServerDriver_PSMoveService::HandleServiceVersionResponse(
-	const PSMResponseMessage *response,
-    void *userdata)
+const char * const *CServerDriver_PSMoveService::GetInterfaceVersions()
 {
-    PSMResult ResultCode = response->result_code;
-    PSMResponseHandle response_handle = response->opaque_response_handle;
-    CServerDriver_PSMoveService *thisPtr = static_cast<CServerDriver_PSMoveService *>(userdata);
+    return vr::k_InterfaceVersions;
+}
 
-    switch (ResultCode)
-    {
-    case PSMResult::PSMResult_Success:
-        {
-			const std::string service_version= response->payload.service_version.version_string;
-			const std::string local_version= PSM_GetClientVersionString();
+vr::ITrackedDeviceServerDriver * CServerDriver_PSMoveService::FindTrackedDeviceDriver(
+    const char * pchId)
+{
+    return m_deviceRegistry.FindDeviceBySteamVRIdentifier(pchId);
+}
 
-			if (service_version == local_version)
-			{
-				DriverLog("CServerDriver_PSMoveService::HandleServiceVersionResponse - Received expected protocol version %s\n", service_version.c_str());
+void CServerDriver_PSMoveService::RunFrame()
+{
+	std::unique_lock<std::recursive_mutex> guard(m_psmClientMutex);
 
-				// Ask the service for a list of connected controllers
-				// Response handled in HandleControllerListReponse()
-				PSM_GetControllerListAsync(nullptr);
+	// Retry the connection to the service once the backoff delay has passed
+	if (m_reconnectScheduler.IsRetryDue())
+	{
+		m_reconnectScheduler.OnAttempt();
+		if (!ReconnectToPSMoveService())
+		{
+			ScheduleReconnectToPSMoveService();
+		}
+	}
 
-				// Ask the service for a list of connected trackers
-				// Response handled in HandleTrackerListReponse()
-				PSM_GetTrackerListAsync(nullptr);
-			}
-			else
-			{
-				DriverLog("CServerDriver_PSMoveService::HandleServiceVersionResponse - Protocol mismatch! Expected %s, got %s. Please reinstall the PSMove Driver!\n",
-						local_version.c_str(), service_version.c_str());
-				thisPtr->Cleanup();
-			}
-        } break;
-    case PSMResult::PSMResult_Error:
-    case PSMResult::PSMResult_Canceled:
-        {
-			DriverLog("CServerDriver_PSMoveService::HandleServiceVersionResponse - Failed to get protocol version\n");
-        } break;
+    // Update any controllers that are currently listening
+	// (the pose publisher thread does this for us when it's running)
+	if (!IsPosePublisherThreadActive())
+	{
+		PSM_UpdateNoPollMessages();
+	}
+
+	// Publish the poses of all the controllers that got a new sample
+	// (a no-op when the pose publisher thread already sent them)
+	PublishControllerPoses();
+
+    // Update all active tracked devices
+	// (the device classes are final, so these calls don't go through the vtable)
+	const std::chrono::time_point<std::chrono::high_resolution_clock> updateStartTime = std::chrono::high_resolution_clock::now();
+
+    for (CPSMoveControllerLatest &controller : m_controllers)
+    {
+        controller.Update();
     }
+
+    for (CPSMoveTrackerLatest &tracker : m_trackers)
+    {
+        tracker.Update();
+    }
+
+	const std::chrono::duration<double> updateTime = std::chrono::high_resolution_clock::now() - updateStartTime;
+	++m_nDeviceUpdateFrameCount;
+	m_deviceUpdateTotalSeconds += updateTime.count();
+	m_deviceUpdateMaxSeconds = std::max(m_deviceUpdateMaxSeconds, updateTime.count());
+
+    // Poll events queued up by the call to PSM_UpdateNoPollMessages().
+	// Done last so a burst of responses/events can't hold up the poses.
+	PollQueuedMessages();
+	IssueQueuedListRequests();
+
+	// Message callbacks can't shut the client down themselves: they run with m_psmClientMutex held
+	// (possibly on the pose publisher thread), and Cleanup() has to join that thread.
+	guard.unlock();
+	if (m_bShutdownRequested)
+	{
+		m_bShutdownRequested = false;
+		Cleanup();
+	}
 }
 
+void CServerDriver_PSMoveService::PollQueuedMessages()
+{
+	const std::chrono::time_point<std::chrono::high_resolution_clock> startTime = std::chrono::high_resolution_clock::now();
+	const std::chrono::microseconds budget(m_messagePollBudgetMicroseconds);
+	int messageCount = 0;
+
+    PSMMessage mesg;
+	for (;;)
+	{
+		// Always handle at least one message per frame so the queue can't stall
+		if (messageCount > 0 && std::chrono::high_resolution_clock::now() - startTime >= budget)
+		{
+			++m_nMessageBudgetExceededCount;
+			break;
+		}
+
+		if (PSM_PollNextMessage(&mesg, sizeof(PSMMessage)) != PSMResult_Success)
+			break;
+
+		m_messageDispatcher.Dispatch(&mesg);
+
+		++messageCount;
+	}
+
+	++m_nMessagePollFrameCount;
+	m_nMessagesHandledCount += messageCount;
+	m_nMaxMessagesPerFrame = std::max(m_nMaxMessagesPerFrame, messageCount);
+}
+
+void CServerDriver_PSMoveService::IssueQueuedListRequests()
+{
+	if (m_bControllerListRefreshQueued)
+	{
+		m_bControllerListRefreshQueued = false;
+
+		// Response handled in HandleControllerListReponse()
+		PSM_GetControllerListAsync(nullptr);
+	}
+
+	if (m_bTrackerListRefreshQueued)
+	{
+		m_bTrackerListRefreshQueued = false;
+
+		// Response handled in HandleTrackerListReponse()
+		PSM_GetTrackerListAsync(nullptr);
+	}
+}
+
+void CServerDriver_PSMoveService::GetMessageStats(
+	char *pchResponseBuffer, 
+	uint32_t unResponseBufferSize)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_psmClientMutex);
+
+	snprintf(pchResponseBuffer, unResponseBufferSize,
+		"frames=%llu messages=%llu max_messages_per_frame=%d budget_us=%d budget_exceeded=%llu list_refreshes_coalesced=%llu",
+		m_nMessagePollFrameCount,
+		m_nMessagesHandledCount,
+		m_nMaxMessagesPerFrame,
+		m_messagePollBudgetMicroseconds,
+		m_nMessageBudgetExceededCount,
+		m_nCoalescedListRefreshCount);
+	pchResponseBuffer[unResponseBufferSize - 1] = '\0';
+}
+
+void CServerDriver_PSMoveService::GetDeviceUpdateStats(
+	char *pchResponseBuffer, 
+	uint32_t unResponseBufferSize)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_psmClientMutex);
+
+	const double averageSeconds = 
+		(m_nDeviceUpdateFrameCount > 0) ? m_deviceUpdateTotalSeconds / static_cast<double>(m_nDeviceUpdateFrameCount) : 0.0;
+
+	snprintf(pchResponseBuffer, unResponseBufferSize,
+		"controllers=%d trackers=%d frames=%llu avg_update_us=%.2f max_update_us=%.2f",
+		static_cast<int>(m_controllers.size()),
+		static_cast<int>(m_trackers.size()),
+		m_nDeviceUpdateFrameCount,
+		averageSeconds * 1000000.0,
+		m_deviceUpdateMaxSeconds * 1000000.0);
+	pchResponseBuffer[unResponseBufferSize - 1] = '\0';
+}
+
+void CServerDriver_PSMoveService::GetDispatchStats(
+	char *pchResponseBuffer, 
+	uint32_t unResponseBufferSize)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_psmClientMutex);
+
+	m_messageDispatcher.GetStats(pchResponseBuffer, unResponseBufferSize);
+}
+
+void CServerDriver_PSMoveService::StartPosePublisherThread()
+{
+	if (m_pPosePublisherThread == nullptr)
+	{
+		DriverLog("CServerDriver_PSMoveService::StartPosePublisherThread - Starting pose publisher thread (poll interval %dus)\n", 
+			m_posePublisherPollIntervalMicroseconds);
+
+		m_bPosePublisherExitSignaled = false;
+		m_pPosePublisherThread = new std::thread(&CServerDriver_PSMoveService::PosePublisherThreadFunction, this);
+
+		#if defined( _WIN32 )
+		// Pose latency is what players notice, so let this thread jump ahead of vrserver's frame work
+		SetThreadPriority(m_pPosePublisherThread->native_handle(), THREAD_PRIORITY_HIGHEST);
+		#endif
+	}
+}
+
+void CServerDriver_PSMoveService::StopPosePublisherThread()
+{
+	if (m_pPosePublisherThread != nullptr)
+	{
+		DriverLog("CServerDriver_PSMoveService::StopPosePublisherThread - Stopping pose publisher thread...\n");
+
+		m_bPosePublisherExitSignaled = true;
+		m_pPosePublisherThread->join();
+		delete m_pPosePublisherThread;
+		m_pPosePublisherThread = nullptr;
+
+		DriverLog("CServerDriver_PSMoveService::StopPosePublisherThread - Pose publisher thread stopped.\n");
+	}
+}
+
+void CServerDriver_PSMoveService::PosePublisherThreadFunction()
+{
+	const std::chrono::microseconds pollInterval(m_posePublisherPollIntervalMicroseconds);
+
+	while (!m_bPosePublisherExitSignaled)
+	{
+		{
+			std::lock_guard<std::recursive_mutex> guard(m_psmClientMutex);
+
+			// Pull in any new controller data frames.
+			// Messages are left queued up for RunFrame() to handle.
+			PSM_UpdateNoPollMessages();
+
+			// Publish the pose of every controller that got a new sample.
+			// Button and axis state is still handed to vrserver from RunFrame().
+			PublishControllerPoses();
+		}
+
+		std::this_thread::sleep_for(pollInterval);
+	}
+}
+
+void CServerDriver_PSMoveService::PublishControllerPoses()
+{
+	const std::chrono::time_point<std::chrono::high_resolution_clock> now = std::chrono::high_resolution_clock::now();
+	int publishedCount = 0;
+
+	// Each controller converts its new sample straight into its driver pose and sends it out
+	for (CPSMoveControllerLatest &controller : m_controllers)
+	{
+		if (controller.GatherLatestPose(now))
+		{
+			controller.FilterLatestPose(now);
+			controller.PublishLatestPose();
+			++publishedCount;
+		}
+	}
+
+	if (publishedCount > 0)
+	{
+		const std::chrono::duration<double> publishTime = std::chrono::high_resolution_clock::now() - now;
+
+		m_nPublishedPoseCount += publishedCount;
+		m_posePublishTotalSeconds += publishTime.count();
+
+		if (m_bAwaitingFirstPoseAfterResume)
+		{
+			const std::chrono::duration<double> timeToFirstPose = 
+				std::chrono::high_resolution_clock::now() - m_serviceDisconnectTime;
+
+			m_lastResumeTimeToFirstPoseSeconds = timeToFirstPose.count();
+			m_bAwaitingFirstPoseAfterResume = false;
+
+			DriverLog("CServerDriver_PSMoveService::PublishControllerPoses - First pose %.0f ms after losing the service (%.0f ms to reconnect)\n",
+				m_lastResumeTimeToFirstPoseSeconds * 1000.0, m_reconnectScheduler.GetLastTimeToConnectSeconds() * 1000.0);
+		}
+	}
+}
+
+void CServerDriver_PSMoveService::GetPosePublishStats(
+	char *pchResponseBuffer, 
+	uint32_t unResponseBufferSize)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_psmClientMutex);
+
+	const double averageSeconds = 
+		(m_nPublishedPoseCount > 0) ? m_posePublishTotalSeconds / static_cast<double>(m_nPublishedPoseCount) : 0.0;
+
+	snprintf(pchResponseBuffer, unResponseBufferSize,
+		"poses=%llu avg_publish_us_per_pose=%.2f",
+		m_nPublishedPoseCount,
+		averageSeconds * 1000000.0);
+	pchResponseBuffer[unResponseBufferSize - 1] = '\0';
+}
+
+bool CServerDriver_PSMoveService::ShouldBlockStandbyMode()
+{
+    return false;
+}
+
+void CServerDriver_PSMoveService::EnterStandby()
+{
+}
+
+void CServerDriver_PSMoveService::LeaveStandby()
+{
+}
+
+// -- Event Handling -----
+void CServerDriver_PSMoveService::RegisterMessageHandlers()
+{
+    // Client Events
+	m_messageDispatcher.RegisterEventHandler(
+		PSMEventMessage::PSMEvent_connectedToService,
+		[](const PSMMessage *, void *userdata) { static_cast<CServerDriver_PSMoveService *>(userdata)->HandleConnectedToPSMoveService(); },
+		this);
+	m_messageDispatcher.RegisterEventHandler(
+		PSMEventMessage::PSMEvent_failedToConnectToService,
+		[](const PSMMessage *, void *userdata) { static_cast<CServerDriver_PSMoveService *>(userdata)->HandleFailedToConnectToPSMoveService(); },
+		this);
+	m_messageDispatcher.RegisterEventHandler(
+		PSMEventMessage::PSMEvent_disconnectedFromService,
+		[](const PSMMessage *, void *userdata) { static_cast<CServerDriver_PSMoveService *>(userdata)->HandleDisconnectedFromPSMoveService(); },
+		this);
+
+    // Service Events
+	// (opaque service events, hmd list updates and system button presses aren't handled, only counted)
+	m_messageDispatcher.RegisterEventHandler(
+		PSMEventMessage::PSMEvent_controllerListUpdated,
+		[](const PSMMessage *, void *userdata) { static_cast<CServerDriver_PSMoveService *>(userdata)->HandleControllerListChanged(); },
+		this);
+	m_messageDispatcher.RegisterEventHandler(
+		PSMEventMessage::PSMEvent_trackerListUpdated,
+		[](const PSMMessage *, void *userdata) { static_cast<CServerDriver_PSMoveService *>(userdata)->HandleTrackerListChanged(); },
+		this);
+    //###HipsterSloth $TODO - Need a notification for when a tracker pose changes
+
+	// Responses
+	m_messageDispatcher.RegisterResponseHandler(
+		PSMResponseMessage::_responsePayloadType_Empty,
+		[](const PSMMessage *message, void *) {
+			DriverLog("NotifyClientPSMoveResponse - request id %d returned result %s.\n",
+				message->response_data.request_id, 
+				(message->response_data.result_code == PSMResult::PSMResult_Success) ? "ok" : "error");
+		},
+		this);
+	m_messageDispatcher.RegisterResponseHandler(
+		PSMResponseMessage::_responsePayloadType_ControllerList,
+		[](const PSMMessage *message, void *userdata) { static_cast<CServerDriver_PSMoveService *>(userdata)->HandleControllerListMessage(&message->response_data); },
+		this);
+	m_messageDispatcher.RegisterResponseHandler(
+		PSMResponseMessage::_responsePayloadType_TrackerList,
+		[](const PSMMessage *message, void *userdata) { static_cast<CServerDriver_PSMoveService *>(userdata)->HandleTrackerListMessage(&message->response_data); },
+		this);
+}
+
+void CServerDriver_PSMoveService::HandleConnectedToPSMoveService()
+{
+	m_reconnectScheduler.OnConnected();
+	DriverLog("CServerDriver_PSMoveService::HandleConnectedToPSMoveService - Connected after %llu attempt(s), %.0f ms\n",
+		m_reconnectScheduler.GetAttemptCount(), m_reconnectScheduler.GetLastTimeToConnectSeconds() * 1000.0);
+
+	DriverLog("CServerDriver_PSMoveService::HandleConnectedToPSMoveService - Request service version, controller and tracker lists\n");
+
+	// Issue all of the startup requests at once rather than waiting on the version check first.
+	// The list responses are held back until the version has been verified.
+	m_serviceVersionState = k_EServiceVersionState_Pending;
+	DiscardPendingDeviceLists();
+	m_bControllerListRefreshQueued = false;
+	m_bTrackerListRefreshQueued = false;
+
+	PSMRequestID request_id;
+	PSM_GetServiceVersionStringAsync(&request_id);
+	PSM_RegisterCallback(request_id, CServerDriver_PSMoveService::HandleServiceVersionResponse, this);
+
+	// Responses handled in HandleControllerListReponse() and HandleTrackerListReponse()
+	PSM_GetControllerListAsync(nullptr);
+	PSM_GetTrackerListAsync(nullptr);
+}
+
+void CServerDriver_PSMoveService::HandleServiceVersionResponse(
+	const PSMResponseMessage *response,
+    void *userdata)
+{
+    PSMResult ResultCode = response->result_code;
+    PSMResponseHandle response_handle = response->opaque_response_handle;
+    CServerDriver_PSMoveService *thisPtr = static_cast<CServerDriver_PSMoveService *>(userdata);
+
+    switch (ResultCode)
+    {
+    case PSMResult::PSMResult_Success:
+        {
+			const std::string service_version= response->payload.service_version.version_string;
+			const std::string local_version= PSM_GetClientVersionString();
+
+			if (service_version == local_version)
+			{
+				DriverLog("CServerDriver_PSMoveService::HandleServiceVersionResponse - Received expected protocol version %s\n", service_version.c_str());
+
+				// The controller and tracker lists were requested along with the version,
+				// so act on whichever of them already arrived
+				thisPtr->m_serviceVersionState = k_EServiceVersionState_Verified;
+				thisPtr->FlushPendingDeviceLists();
+			}
+			else
+			{
+				DriverLog("CServerDriver_PSMoveService::HandleServiceVersionResponse - Protocol mismatch! Expected %s, got %s. Please reinstall the PSMove Driver!\n",
+						local_version.c_str(), service_version.c_str());
+				thisPtr->m_serviceVersionState = k_EServiceVersionState_Failed;
+				thisPtr->DiscardPendingDeviceLists();
+
+				// Shut down from RunFrame() once the client mutex is released
+				thisPtr->m_bShutdownRequested = true;
+			}
+        } break;
+    case PSMResult::PSMResult_Error:
+    case PSMResult::PSMResult_Canceled:
+        {
+			DriverLog("CServerDriver_PSMoveService::HandleServiceVersionResponse - Failed to get protocol version\n");
+			thisPtr->m_serviceVersionState = k_EServiceVersionState_Failed;
+			thisPtr->DiscardPendingDeviceLists();
+        } break;
+    }
+}
+
+
+void CServerDriver_PSMoveService::HandleFailedToConnectToPSMoveService()
+{
+	DriverLog("CServerDriver_PSMoveService::HandleFailedToConnectToPSMoveService - Called\n");
+
+    // Try again after a backoff delay (rather than hammering the service every frame)
+    ScheduleReconnectToPSMoveService();
+}
+
+void CServerDriver_PSMoveService::HandleDisconnectedFromPSMoveService()
+{
+	DriverLog("CServerDriver_PSMoveService::HandleDisconnectedFromPSMoveService - Called\n");
+
+	// Keep every device registered with vrserver (reporting out of range) rather than deactivating it.
+	// The controller list we get after reconnecting re-binds the controllers and restarts their streams.
+    for (CPSMoveControllerLatest &controller : m_controllers)
+    {
+		m_deviceRegistry.UnbindControllerId(controller.getPSMControllerId(), &controller);
+		controller.EnterReconnectingState();
+    }
+
+    for (CPSMoveTrackerLatest &tracker : m_trackers)
+    {
+		tracker.EnterReconnectingState();
+    }
+
+	m_serviceDisconnectTime = std::chrono::high_resolution_clock::now();
+	m_bAwaitingFirstPoseAfterResume = true;
+
+	m_serviceVersionState = k_EServiceVersionState_Pending;
+	DiscardPendingDeviceLists();
+
+    // Try to reconnect to the service after a short delay, backing off if it stays down
+	m_reconnectScheduler.OnDisconnected();
+    ScheduleReconnectToPSMoveService();
+}
+
+void CServerDriver_PSMoveService::HandleControllerListChanged()
+{
+	DriverLog("CServerDriver_PSMoveService::HandleControllerListChanged - Called\n");
+
+    // Ask the service for a list of connected controllers at the end of the frame
+	if (m_bControllerListRefreshQueued)
+	{
+		++m_nCoalescedListRefreshCount;
+	}
+	m_bControllerListRefreshQueued = true;
+}
+
+void CServerDriver_PSMoveService::HandleTrackerListChanged()
+{
+	DriverLog("CServerDriver_PSMoveService::HandleTrackerListChanged - Called\n");
+
+    // Ask the service for a list of connected trackers at the end of the frame
+	if (m_bTrackerListRefreshQueued)
+	{
+		++m_nCoalescedListRefreshCount;
+	}
+	m_bTrackerListRefreshQueued = true;
+}
+
+// -- Response Handling -----
+void CServerDriver_PSMoveService::HandleControllerListMessage(
+    const PSMResponseMessage *response)
+{
+    DriverLog("NotifyClientPSMoveResponse - Controller Count = %d (request id %d).\n", 
+        response->payload.controller_list.count, response->request_id);
+
+	if (m_serviceVersionState == k_EServiceVersionState_Verified)
+	{
+		HandleControllerListReponse(&response->payload.controller_list, response->opaque_request_handle);
+	}
+	else if (m_serviceVersionState == k_EServiceVersionState_Pending)
+	{
+		// Hold on to the latest list until the version check comes back
+		m_pendingControllerList = response->payload.controller_list;
+		m_bHasPendingControllerList = true;
+	}
+}
+
+void CServerDriver_PSMoveService::HandleTrackerListMessage(
+    const PSMResponseMessage *response)
+{
+    DriverLog("NotifyClientPSMoveResponse - Tracker Count = %d (request id %d).\n",
+        response->payload.tracker_list.count, response->request_id);
+
+	if (m_serviceVersionState == k_EServiceVersionState_Verified)
+	{
+		HandleTrackerListReponse(&response->payload.tracker_list);
+	}
+	else if (m_serviceVersionState == k_EServiceVersionState_Pending)
+	{
+		m_pendingTrackerList = response->payload.tracker_list;
+		m_bHasPendingTrackerList = true;
+	}
+}
+
+void CServerDriver_PSMoveService::FlushPendingDeviceLists()
+{
+	// Trackers first so they're around by the time the controllers start streaming
+	if (m_bHasPendingTrackerList)
+	{
+		m_bHasPendingTrackerList = false;
+		HandleTrackerListReponse(&m_pendingTrackerList);
+	}
+
+	if (m_bHasPendingControllerList)
+	{
+		m_bHasPendingControllerList = false;
+		HandleControllerListReponse(&m_pendingControllerList, nullptr);
+	}
+}
+
+void CServerDriver_PSMoveService::DiscardPendingDeviceLists()
+{
+	m_bHasPendingControllerList = false;
+	m_bHasPendingTrackerList = false;
+}
+
+void CServerDriver_PSMoveService::HandleControllerListReponse(
+    const PSMControllerList *controller_list,
+	const PSMResponseHandle response_handle)
+{
+	DriverLog("CServerDriver_PSMoveService::HandleControllerListReponse - Received %d controllers\n", controller_list->count);
+
+	// Controllers are identified by serial rather than by PSM controller id,
+	// since the service is free to renumber controllers (e.g. after it restarts).
+	// The new list is diffed against the devices we already have:
+	// * unknown serials are allocated as new devices
+	// * known serials under a different id (or coming back) are re-bound to the new id
+	// * known devices missing from the list are marked disconnected but keep their SteamVR slot
+	CPSMoveControllerLatest *listedControllers[PSMOVESERVICE_MAX_CONTROLLER_COUNT];
+	CPSMoveControllerLatest *reboundControllers[PSMOVESERVICE_MAX_CONTROLLER_COUNT];
+	PSMControllerID reboundControllerIds[PSMOVESERVICE_MAX_CONTROLLER_COUNT];
+	int listedCount = 0;
+	int reboundCount = 0;
+	int addedCount = 0;
+	int removedCount = 0;
+	bool bAnyNaviControllers= false;
+	bool bAnyNewControllers= false;
+
+	// Pass 1: match the listed controllers to existing devices.
+	// All old ids are released before any new id is acquired so that swapped ids
+	// don't stop each other's data streams.
+    for (int list_index = 0; list_index < controller_list->count; ++list_index)
+    {
+        PSMControllerID psmControllerId = controller_list->controller_id[list_index];
+        PSMControllerType psmControllerType = controller_list->controller_type[list_index];
+
+		if (psmControllerType == PSMControllerType::PSMController_Navi)
+		{
+			// Take care of this is the last pass once all of the PSMove controllers have been setup
+			bAnyNaviControllers= true;
+			continue;
+		}
+
+		if (psmControllerType != PSMControllerType::PSMController_Move && 
+			psmControllerType != PSMControllerType::PSMController_DualShock4)
+		{
+			continue;
+		}
+
+		CPSMoveControllerLatest *existingController= 
+			m_deviceRegistry.FindControllerBySerial(controller_list->controller_serial[list_index]);
+
+		if (existingController == nullptr)
+		{
+			bAnyNewControllers= true;
+			continue;
+		}
+
+		listedControllers[listedCount++]= existingController;
+
+		if (!existingController->HasPSMControllerId(psmControllerId) || !existingController->IsListedByService())
+		{
+			DriverLog("CServerDriver_PSMoveService::HandleControllerListReponse - Re-bind %s from id %d to id %d\n", 
+				existingController->GetSteamVRIdentifier(), existingController->getPSMControllerId(), psmControllerId);
+
+			if (existingController->IsListedByService())
+			{
+				m_deviceRegistry.UnbindControllerId(existingController->getPSMControllerId(), existingController);
+				existingController->ReleasePSMController();
+			}
+
+			reboundControllers[reboundCount]= existingController;
+			reboundControllerIds[reboundCount]= psmControllerId;
+			++reboundCount;
+		}
+    }
+
+	// Pass 2: known controllers that are no longer listed
+    for (auto it = m_controllers.begin(); it != m_controllers.end(); ++it)
+    {
+		CPSMoveControllerLatest *controller= &(*it);
+		if ((!controller->IsListedByService() && !controller->IsReconnecting()) || 
+			std::find(listedControllers, listedControllers + listedCount, controller) != listedControllers + listedCount)
+		{
+			continue;
+		}
+
+		DriverLog("CServerDriver_PSMoveService::HandleControllerListReponse - Removed %s (id %d)\n", 
+			controller->GetSteamVRIdentifier(), controller->getPSMControllerId());
+
+		m_deviceRegistry.UnbindControllerId(controller->getPSMControllerId(), controller);
+		controller->ReleasePSMController();
+		controller->PublishDisconnectedPose();
+		++removedCount;
+	}
+
+	// Pass 3: bind re-numbered and returning controllers to their new ids.
+	// After a service restart this restarts all of the data streams in one go,
+	// without waiting on each start request.
+	if (reboundCount > 0)
+	{
+		DriverLog("CServerDriver_PSMoveService::HandleControllerListReponse - Resuming %d controller stream(s)\n", reboundCount);
+	}
+
+	for (int rebound_index = 0; rebound_index < reboundCount; ++rebound_index)
+	{
+		reboundControllers[rebound_index]->AcquirePSMController(reboundControllerIds[rebound_index]);
+		m_deviceRegistry.BindControllerId(reboundControllers[rebound_index], reboundControllerIds[rebound_index]);
+	}
+
+	// Pass 4: allocate devices for the serials we haven't seen before
+	if (bAnyNewControllers)
+	{
+		// The allocators skip serials that already have a device (and the HMD's serial),
+		// so count what actually got added rather than what was listed
+		const size_t controllerCountBefore = m_controllers.size();
+
+		for (int list_index = 0; list_index < controller_list->count; ++list_index)
+		{
+			PSMControllerID psmControllerId = controller_list->controller_id[list_index];
+			PSMControllerType psmControllerType = controller_list->controller_type[list_index];
+			const char *psmControllerSerial = controller_list->controller_serial[list_index];
+
+			switch (psmControllerType)
+			{
+			case PSMControllerType::PSMController_Move:
+				DriverLog("CServerDriver_PSMoveService::HandleControllerListReponse - Allocate PSMove(%d)\n", psmControllerId);
+				AllocateUniquePSMoveController(psmControllerId, psmControllerSerial);
+				break;
+			case PSMControllerType::PSMController_DualShock4:
+				DriverLog("CServerDriver_PSMoveService::HandleControllerListReponse - Allocate PSDualShock4(%d)\n", psmControllerId);
+				AllocateUniqueDualShock4Controller(psmControllerId, psmControllerSerial);
+				break;
+			default:
+				break;
+			}
+		}
+
+		addedCount = static_cast<int>(m_controllers.size() - controllerCountBefore);
+	}
+
+	if (bAnyNaviControllers)
+	{
+		for (int list_index = 0; list_index < controller_list->count; ++list_index)
+		{
+			int controller_id = controller_list->controller_id[list_index];
+			PSMControllerType controller_type = controller_list->controller_type[list_index];
+			const char *ControllerSerial = controller_list->controller_serial[list_index];
+			const char *ParentControllerSerial = controller_list->parent_controller_serial[list_index];
+
+			if (controller_type == PSMControllerType::PSMController_Navi)
+			{
+				DriverLog("CServerDriver_PSMoveService::HandleControllerListReponse - Attach PSNavi(%d)\n", controller_id);
+				AttachPSNaviToParentController(controller_id, ControllerSerial, ParentControllerSerial);
+			}
+		}
+	}
+
+	DriverLog("CServerDriver_PSMoveService::HandleControllerListReponse - %d added, %d removed, %d re-bound\n", 
+		addedCount, removedCount, reboundCount);
+}
+
+void CServerDriver_PSMoveService::HandleTrackerListReponse(
+    const PSMTrackerList *tracker_list)
+{
+	DriverLog("CServerDriver_PSMoveService::HandleTrackerListReponse - Received %d trackers\n", tracker_list->count);
+
+	// The tracker list doesn't carry serials, so trackers keep their id based identity.
+	// Listed trackers get their (possibly re-calibrated) info refreshed,
+	// unlisted ones are marked disconnected but keep their SteamVR slot.
+	bool bIsListedTrackerId[PSMOVESERVICE_MAX_TRACKER_COUNT];
+	memset(bIsListedTrackerId, 0, sizeof(bIsListedTrackerId));
+
+    for (int list_index = 0; list_index < tracker_list->count; ++list_index)
+    {
+        const PSMClientTrackerInfo *trackerInfo = &tracker_list->trackers[list_index];
+		CPSMoveTrackerLatest *existingTracker = m_deviceRegistry.FindTrackerById(trackerInfo->tracker_id);
+
+		if (trackerInfo->tracker_id >= 0 && trackerInfo->tracker_id < PSMOVESERVICE_MAX_TRACKER_COUNT)
+		{
+			bIsListedTrackerId[trackerInfo->tracker_id] = true;
+		}
+
+		if (existingTracker != nullptr)
+		{
+			existingTracker->SetClientTrackerInfo(trackerInfo);
+		}
+		else
+		{
+			AllocateUniquePSMoveTracker(trackerInfo);
+		}
+    }
+
+	for (int tracker_id = 0; tracker_id < PSMOVESERVICE_MAX_TRACKER_COUNT; ++tracker_id)
+	{
+		CPSMoveTrackerLatest *tracker = m_deviceRegistry.FindTrackerById(tracker_id);
+
+		if (tracker != nullptr && !bIsListedTrackerId[tracker_id] && tracker->IsListedByService())
+		{
+			DriverLog("CServerDriver_PSMoveService::HandleTrackerListReponse - Removed %s\n", tracker->GetSteamVRIdentifier());
+			tracker->SetRemovedFromService();
+		}
+	}
+}
+
+void CServerDriver_PSMoveService::SetHMDTrackingSpace(
+    const PSMPosef &origin_pose)
+{
+	#if LOG_REALIGN_TO_HMD != 0
+		DriverLog("Begin CServerDriver_PSMoveService::SetHMDTrackingSpace()\n");
+	#endif
+
+	// Can be called from vrserver's debug request thread
+	std::lock_guard<std::recursive_mutex> guard(m_psmClientMutex);
+
+    m_worldFromDriverPose = origin_pose;
+
+    // Tell all the devices that the relationship between the psmove and the OpenVR
+    // tracking spaces changed
+    for (CPSMoveControllerLatest &controller : m_controllers)
+    {
+        controller.RefreshWorldFromDriverPose();
+    }
+
+    for (CPSMoveTrackerLatest &tracker : m_trackers)
+    {
+        tracker.RefreshWorldFromDriverPose();
+    }
+}
+
+static void GenerateControllerSteamVRIdentifier( char *p, int psize, int controller, const char *serial )
+{
+	// Keyed on the serial (minus the separators) so the controller keeps its SteamVR slot when the service renumbers it
+	char serialKey[CPSMoveTrackedDeviceRegistry::k_maxKeyLength];
+	int keyLength= 0;
+
+	for (const char *pch = serial; pch != nullptr && *pch != '\0' && keyLength + 1 < static_cast<int>(sizeof(serialKey)); ++pch)
+	{
+		if (isalnum(static_cast<unsigned char>(*pch)))
+		{
+			serialKey[keyLength++]= static_cast<char>(::toupper(static_cast<unsigned char>(*pch)));
+		}
+	}
+	serialKey[keyLength]= '\0';
+
+	if (keyLength > 0)
+	{
+		snprintf(p, psize, "psmove_controller_%s", serialKey);
+	}
+	else
+	{
+		snprintf(p, psize, "psmove_controller%d", controller);
+	}
+}
+
+void CServerDriver_PSMoveService::AllocateUniquePSMoveController(PSMControllerID psmControllerID, const char *psmControllerSerial)
+{
+    if ( m_deviceRegistry.FindControllerBySerial(psmControllerSerial) == nullptr )
+    {	
+		char psmSerialNo[CPSMoveTrackedDeviceRegistry::k_maxKeyLength];
+		CPSMoveTrackedDeviceRegistry::NormalizeKey(psmControllerSerial, psmSerialNo, sizeof(psmSerialNo));
+
+		if (0 != m_strPSMoveHMDSerialNo.compare(psmSerialNo)) 
+		{
+			DriverLog( "added new psmove controller id: %d, serial: %s\n", psmControllerID, psmSerialNo);
+
+            m_controllers.emplace_back(psmControllerID, PSMControllerType::PSMController_Move, psmSerialNo);
+            CPSMoveControllerLatest *TrackedDevice= &m_controllers.back();
+			m_deviceRegistry.AddController(TrackedDevice);
+
+			// Don't wait on vrserver activating the device to get the data flowing
+			TrackedDevice->StartControllerDataStream();
+
+			if (vr::VRServerDriverHost())
+			{
+				vr::VRServerDriverHost()->TrackedDeviceAdded(TrackedDevice->GetSteamVRIdentifier(), vr::TrackedDeviceClass_Controller, TrackedDevice);
+			}
+		}
+		else
+		{
+			DriverLog("skipped new psmove controller as configured for HMD tracking, serial: %s\n", psmSerialNo);
+		}
+    }
+}
+
+
+void CServerDriver_PSMoveService::AllocateUniqueDualShock4Controller(PSMControllerID psmControllerID, const char *psmControllerSerial)
+{
+    if (m_deviceRegistry.FindControllerBySerial(psmControllerSerial) == nullptr)
+    {
+		char psmSerialNo[CPSMoveTrackedDeviceRegistry::k_maxKeyLength];
+		CPSMoveTrackedDeviceRegistry::NormalizeKey(psmControllerSerial, psmSerialNo, sizeof(psmSerialNo));
+
+		DriverLog( "added new dualshock4 controller id: %d, serial: %s\n", psmControllerID, psmSerialNo);
+
+        m_controllers.emplace_back(psmControllerID, PSMControllerType::PSMController_DualShock4, psmSerialNo);
+        CPSMoveControllerLatest *TrackedDevice= &m_controllers.back();
+		m_deviceRegistry.AddController(TrackedDevice);
+
+		// Don't wait on vrserver activating the device to get the data flowing
+		TrackedDevice->StartControllerDataStream();
+
+		if (vr::VRServerDriverHost())
+		{
+			vr::VRServerDriverHost()->TrackedDeviceAdded(TrackedDevice->GetSteamVRIdentifier(), vr::TrackedDeviceClass_Controller, TrackedDevice);
+		}
+    }
+}
+
+void CServerDriver_PSMoveService::AttachPSNaviToParentController(PSMControllerID NaviControllerID, const char *NaviControllerSerial, const char *ParentControllerSerial)
+{
+	char naviSerialNo[CPSMoveTrackedDeviceRegistry::k_maxKeyLength];
+	char parentSerialNo[CPSMoveTrackedDeviceRegistry::k_maxKeyLength];
+	CPSMoveTrackedDeviceRegistry::NormalizeKey(NaviControllerSerial, naviSerialNo, sizeof(naviSerialNo));
+	CPSMoveTrackedDeviceRegistry::NormalizeKey(ParentControllerSerial, parentSerialNo, sizeof(parentSerialNo));
+
+	CPSMoveControllerLatest *parent_controller= m_deviceRegistry.FindControllerBySerial(parentSerialNo);
+
+	if (parent_controller != nullptr)
+	{
+		if (parent_controller->getPSMControllerType() == PSMController_Move)
+		{
+			if (parent_controller->AttachChildPSMController(NaviControllerID, PSMController_Navi, naviSerialNo))
+			{
+				DriverLog("Attached navi controller serial %s to controller serial %s\n", naviSerialNo, parentSerialNo);
+			}
+			else
+			{
+				DriverLog("Failed to attach navi controller serial %s to controller serial %s\n", naviSerialNo, parentSerialNo);
+			}
+		}
+		else
+		{
+			DriverLog("Failed to attach navi controller serial %s to non-psmove controller serial %s\n", naviSerialNo, parentSerialNo);
+		}
+	}
+	else
+	{
+		DriverLog("Failed to find parent controller serial %s for navi controller serial %s\n", parentSerialNo, naviSerialNo);
+	}
+}
+
+static void GenerateTrackerSerialNumber(char *p, int psize, int tracker)
+{
+    snprintf(p, psize, "psmove_tracker%d", tracker);
+}
+
+void CServerDriver_PSMoveService::AllocateUniquePSMoveTracker(const PSMClientTrackerInfo *trackerInfo)
+{
+    if (m_deviceRegistry.FindTrackerById(trackerInfo->tracker_id) == nullptr)
+    {
+        m_trackers.emplace_back(trackerInfo);
+        CPSMoveTrackerLatest *TrackerDevice= &m_trackers.back();
+        DriverLog("added new tracker device %s\n", TrackerDevice->GetSteamVRIdentifier());
+
+		m_deviceRegistry.AddTracker(TrackerDevice);
+
+        if (vr::VRServerDriverHost())
+        {
+            vr::VRServerDriverHost()->TrackedDeviceAdded(TrackerDevice->GetSteamVRIdentifier(), vr::TrackedDeviceClass_TrackingReference, TrackerDevice);
+        }
+    }
+}
+
+
+// The monitor_psmove is a companion program which can display overlay prompts for us
+// and tell us the pose of the HMD at the moment we want to calibrate.
+void CServerDriver_PSMoveService::LaunchPSMoveMonitor_Internal( const char * pchDriverInstallDir )
+{
+#if LOG_REALIGN_TO_HMD != 0
+	DriverLog("Entered CServerDriver_PSMoveService::LaunchPSMoveMonitor_Internal(%s)\n", pchDriverInstallDir);
+#endif
+
+    m_bLaunchedPSMoveMonitor = true;
+
+    std::ostringstream path_and_executable_string_builder;
+
+    path_and_executable_string_builder << pchDriverInstallDir;
+#if defined( _WIN64 )
+    path_and_executable_string_builder << "\\bin\\win64";
+#elif defined( _WIN32 )
+    path_and_executable_string_builder << "\\bin\\win32";
+#elif defined(__APPLE__) 
+    path_and_executable_string_builder << "/bin/osx";
+#else 
+    #error Do not know how to launch psmove_monitor
+#endif
+
+
+#if defined( _WIN32 ) || defined( _WIN64 )
+	path_and_executable_string_builder << "\\monitor_psmove.exe";
+	const std::string monitor_path_and_exe = path_and_executable_string_builder.str();
+
+	std::ostringstream args_string_builder;
+	args_string_builder << "monitor_psmove.exe \"" << pchDriverInstallDir << "\\resources\"";
+	const std::string monitor_args = args_string_builder.str();
+	
+	char monitor_args_cstr[1024];
+	strncpy_s(monitor_args_cstr, monitor_args.c_str(), sizeof(monitor_args_cstr) - 1);
+	monitor_args_cstr[sizeof(monitor_args_cstr) - 1] = '\0';
+
+	#if LOG_REALIGN_TO_HMD != 0
+		DriverLog("CServerDriver_PSMoveService::LaunchPSMoveMonitor_Internal() monitor_psmove windows full path: %s\n", monitor_path_and_exe.c_str());
+		DriverLog("CServerDriver_PSMoveService::LaunchPSMoveMonitor_Internal() monitor_psmove windows args: %s\n", monitor_args_cstr);
+	#endif
+
+	STARTUPINFOA sInfoProcess = { 0 };
+	sInfoProcess.cb = sizeof(STARTUPINFOW);
+	PROCESS_INFORMATION pInfoStartedProcess;
+	BOOL bSuccess = CreateProcessA(monitor_path_and_exe.c_str(), monitor_args_cstr, NULL, NULL, FALSE, 0, NULL, NULL, &sInfoProcess, &pInfoStartedProcess);
+	DWORD ErrorCode = (bSuccess == TRUE) ? 0 : GetLastError();
+
+	DriverLog("CServerDriver_PSMoveService::LaunchPSMoveMonitor_Internal() Start monitor_psmove CreateProcessA() result: %d.\n", ErrorCode);
+
+#elif defined(__APPLE__) 
+    pid_t processId;
+    if ((processId = fork()) == 0)
+    {
+		path_and_executable_string_builder << "\\monitor_psmove";
+
+		const std::string monitor_exe_path = path_and_executable_string_builder.str();
+        const char * argv[] = { monitor_exe_path.c_str(), pchDriverInstallDir, NULL };
+        
+        if (execv(app, argv) < 0)
+        {
+            DriverLog( "Failed to exec child process\n");
+        }
+    }
+    else if (processId < 0)
+    {
+        DriverLog( "Failed to fork child process\n");
+        perror("fork error");
+    }
+#else 
+#error Do not know how to launch psmove config tool
+#endif
+}
+
+/** Launch monitor_psmove if needed (requested by devices as they activate) */
+void CServerDriver_PSMoveService::LaunchPSMoveMonitor()
+{
+    if ( m_bLaunchedPSMoveMonitor )
+	{
+        return;
+	}
+
+	#if LOG_REALIGN_TO_HMD != 0
+	DriverLog("CServerDriver_PSMoveService::LaunchPSMoveMonitor() - Called\n");
+	#endif
+
+    //###HipsterSloth $TODO - Ideally we would get the install path as a property, but this property fetch doesn't seem to work...
+	//vr::ETrackedPropertyError errorCode;
+	//std::string driverInstallDir= vr::VRProperties()->GetStringProperty(requestingDevicePropertyHandle, vr::Prop_InstallPath_String, &errorCode);
+
+    //...so for now, just assume that we're running out of the steamvr folder
+    char szCurrentDirectory[MAX_PATH];
+    if (getcwd(szCurrentDirectory, MAX_PATH - 1) != 0)
+    {
+        DriverLog("CServerDriver_PSMoveService::LaunchPSMoveMonitor() - vrserver working directory: %s\n", szCurrentDirectory);
+
+	    std::ostringstream driverInstallDirBuilder;
+        driverInstallDirBuilder << szCurrentDirectory;
+        #if defined( _WIN64 ) || defined( _WIN32 )
+            driverInstallDirBuilder << "\\drivers\\psmove";
+        #else
+            driverInstallDirBuilder << "/drivers/psmove";
+        #endif
+	    const std::string driverInstallDir = driverInstallDirBuilder.str();
+
+	    LaunchPSMoveMonitor_Internal( driverInstallDir.c_str() );
+    }
+    else
+    {
+        DriverLog("CServerDriver_PSMoveService::LaunchPSMoveMonitor() - Failed to fetch current directory\n");
+    }
+}
+
+//==================================================================================================
+// Tracked Device Driver
+//==================================================================================================
+
+CPSMoveTrackedDeviceLatest::CPSMoveTrackedDeviceLatest()
+    : m_ulPropertyContainer(vr::k_ulInvalidPropertyContainer)
+    , m_unSteamVRTrackedDeviceId(vr::k_unTrackedDeviceIndexInvalid)
+{
+    memset(&m_Pose, 0, sizeof(m_Pose));
+    m_Pose.result = vr::TrackingResult_Uninitialized;
+
+    // By default, assume that the tracked devices are in the tracking space as OpenVR
+    m_Pose.qWorldFromDriverRotation.w = 1.f;
+    m_Pose.qWorldFromDriverRotation.x = 0.f;
+    m_Pose.qWorldFromDriverRotation.y = 0.f;
+    m_Pose.qWorldFromDriverRotation.z = 0.f;
+    m_Pose.vecWorldFromDriverTranslation[0] = 0.f;
+    m_Pose.vecWorldFromDriverTranslation[1] = 0.f;
+    m_Pose.vecWorldFromDriverTranslation[2] = 0.f;
+
+    m_firmware_revision = 0x0001;
+    m_hardware_revision = 0x0001;
+
+	m_lastHMDPoseInMeters= *k_psm_pose_identity;
+	m_lastHMDPoseTime= std::chrono::time_point<std::chrono::high_resolution_clock>();
+	m_bIsLastHMDPoseValid= false;
+	m_hmdResultCallback = nullptr;
+	m_hmdResultUserData = nullptr;
+}
+
+CPSMoveTrackedDeviceLatest::~CPSMoveTrackedDeviceLatest()
+{
+}
+
+// Shared Implementation of vr::ITrackedDeviceServerDriver
+vr::EVRInitError CPSMoveTrackedDeviceLatest::Activate(vr::TrackedDeviceIndex_t unObjectId)
+{
+	std::lock_guard<std::recursive_mutex> guard(g_ServerTrackedDeviceProvider.GetPSMClientMutex());
+	vr::CVRPropertyHelpers *properties= vr::VRProperties();
+
+    DriverLog("CPSMoveTrackedDeviceLatest::Activate: %s is object id %d\n", GetSteamVRIdentifier(), unObjectId);
+	m_ulPropertyContainer = properties->TrackedDeviceToPropertyContainer( unObjectId );
+    m_unSteamVRTrackedDeviceId = unObjectId;
+
+	properties->SetBoolProperty(m_ulPropertyContainer, vr::Prop_Firmware_UpdateAvailable_Bool, false);
+	properties->SetBoolProperty(m_ulPropertyContainer, vr::Prop_Firmware_ManualUpdate_Bool, false);
+	properties->SetBoolProperty(m_ulPropertyContainer, vr::Prop_ContainsProximitySensor_Bool, false);
+	properties->SetBoolProperty(m_ulPropertyContainer, vr::Prop_HasCamera_Bool, false);
+	properties->SetBoolProperty(m_ulPropertyContainer, vr::Prop_Firmware_ForceUpdateRequired_Bool, false);
+	properties->SetBoolProperty(m_ulPropertyContainer, vr::Prop_DeviceCanPowerOff_Bool, false);
+	properties->SetUint64Property(m_ulPropertyContainer, vr::Prop_HardwareRevision_Uint64, m_hardware_revision);
+	properties->SetUint64Property(m_ulPropertyContainer, vr::Prop_FirmwareVersion_Uint64, m_firmware_revision);
+
+    return vr::VRInitError_None;
+}
+
+void CPSMoveTrackedDeviceLatest::Deactivate() 
+{
+	std::lock_guard<std::recursive_mutex> guard(g_ServerTrackedDeviceProvider.GetPSMClientMutex());
+    DriverLog("CPSMoveTrackedDeviceLatest::Deactivate: %s was object id %d\n", GetSteamVRIdentifier(), m_unSteamVRTrackedDeviceId);
+    m_unSteamVRTrackedDeviceId = vr::k_unTrackedDeviceIndexInvalid;
+}
+
+void CPSMoveTrackedDeviceLatest::EnterStandby()
+{
+    //###HipsterSloth $TODO - No good way to do this at the moment
+}
+
+void *CPSMoveTrackedDeviceLatest::GetComponent(const char *pchComponentNameAndVersion)
+{
+    return NULL;
+}
+
+void CPSMoveTrackedDeviceLatest::DebugRequest(
+    const char * pchRequest,
+    char * pchResponseBuffer,
+    uint32_t unResponseBufferSize)
+{
+	std::lock_guard<std::recursive_mutex> guard(g_ServerTrackedDeviceProvider.GetPSMClientMutex());
+	std::istringstream ss( pchRequest );
+	std::string strCmd;
+
+	ss >> strCmd;
+	if (strCmd == "psmove:hmd_pose")
+	{
+		#if LOG_REALIGN_TO_HMD != 0
+			DriverLog( "CPSMoveTrackedDeviceLatest::DebugRequest(): %s\n", strCmd.c_str() );
+		#endif
+
+		// monitor_psmove is calling us back with HMD tracking information
+		vr::HmdMatrix34_t hmdTransform;
+
+
+		#if LOG_REALIGN_TO_HMD != 0
+			std::ostringstream matrixStringBuilder;
+			matrixStringBuilder << "hmdTransform.m:\n\t";
+		#endif
+
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int j = 0; j < 4; ++j)
+			{
+				ss >> hmdTransform.m[i][j];
+				#if LOG_REALIGN_TO_HMD != 0
+					matrixStringBuilder << "[" << hmdTransform.m[i][j] << "] ";
+				#endif
+			}
+			#if LOG_REALIGN_TO_HMD != 0
+				matrixStringBuilder << "\n\t";
+			#endif
+		}
+
+		m_lastHMDPoseInMeters = openvrMatrixExtractPSMPosef(hmdTransform);
+
+		#if LOG_REALIGN_TO_HMD != 0
+			matrixStringBuilder << "\n";
+			DriverLog(matrixStringBuilder.str().c_str());
+
+			DriverLog("Extracted pose: %s \n", PSMPosefToString(m_lastHMDPoseInMeters).c_str() );
+		#endif
+
+		m_lastHMDPoseTime = std::chrono::high_resolution_clock::now();
+
+		if (m_hmdResultCallback != nullptr)
+		{
+			m_hmdResultCallback(m_lastHMDPoseInMeters, m_hmdResultUserData);
+			m_hmdResultCallback = nullptr;
+			m_hmdResultUserData = nullptr;
+		}
+	}
+	else if (strCmd == "psmove:provider_stats")
+	{
+		// Reports the stats shared by every device (all sections, or just the one named after the command)
+		if (pchResponseBuffer != nullptr && unResponseBufferSize > 0)
+		{
+			std::string strSection;
+
+			ss >> strSection;
+			g_ServerTrackedDeviceProvider.GetProviderStats(strSection, pchResponseBuffer, unResponseBufferSize);
+		}
+	}
+}
+
+void CPSMoveTrackedDeviceLatest::RequestLatestHMDPose(
+	float maxPoseAgeMilliseconds,
+	CPSMoveTrackedDeviceLatest::t_hmd_request_callback callback,
+	void *userdata)
+{
+	#if LOG_REALIGN_TO_HMD != 0
+		DriverLog("Begin CPSMoveTrackedDeviceLatest::RequestLatestHMDPose()\n");
+	#endif
+
+	assert(m_hmdResultCallback == nullptr || m_hmdResultCallback == callback);
+
+	if (m_hmdResultCallback == nullptr)
+	{
+		bool bUsedCachedHMDPose;
+
+		if (m_bIsLastHMDPoseValid)
+		{
+			std::chrono::duration<float, std::milli> hmdPoseAge =
+				std::chrono::high_resolution_clock::now() - m_lastHMDPoseTime;
+
+			bUsedCachedHMDPose = hmdPoseAge.count() < maxPoseAgeMilliseconds;
+		}
+		else
+		{
+			bUsedCachedHMDPose = false;
+		}
+
+		if (bUsedCachedHMDPose)
+		{
+			// Give the callback the cached pose immediately
+			if (callback != nullptr)
+			{
+				callback(m_lastHMDPoseInMeters, userdata);
+			}
+		}
+		else
+		{
+			static vr::VREvent_Data_t nodata = { 0 };
+
+			// Register the callback
+			m_hmdResultCallback = callback;
+			m_hmdResultUserData = userdata;
+
+			// Ask monitor_psmove to tell us the latest HMD pose
+			vr::VRServerDriverHost()->VendorSpecificEvent(
+				m_unSteamVRTrackedDeviceId,
+				(vr::EVREventType) (vr::VREvent_VendorSpecific_Reserved_Start + 0),
+				nodata,
+				0);
+		}
+	}
+}
+
+vr::DriverPose_t CPSMoveTrackedDeviceLatest::GetPose()
+{
+    // This is only called at startup to synchronize with the driver.
+    // Future updates are driven by our thread calling TrackedDevicePoseUpdated()
+    return m_Pose;
+}
+
+// CPSMoveTrackedDeviceLatest Interface
+vr::ETrackedDeviceClass CPSMoveTrackedDeviceLatest::GetTrackedDeviceClass() const
+{
+    return vr::TrackedDeviceClass_Invalid;
+}
+
+bool CPSMoveTrackedDeviceLatest::IsActivated() const
+{
+    return m_unSteamVRTrackedDeviceId != vr::k_unTrackedDeviceIndexInvalid;
+}
+
+void CPSMoveTrackedDeviceLatest::Update()
+{
+}
+
+void CPSMoveTrackedDeviceLatest::RefreshWorldFromDriverPose()
+{
+	#if LOG_REALIGN_TO_HMD != 0
+		DriverLog( "Begin CServerDriver_PSMoveService::RefreshWorldFromDriverPose() for device %s\n", GetSteamVRIdentifier() );
+	#endif
+
+    const PSMPosef worldFromDriverPose = g_ServerTrackedDeviceProvider.GetWorldFromDriverPose();
+
+	#if LOG_REALIGN_TO_HMD != 0
+		DriverLog("worldFromDriverPose: %s \n", PSMPosefToString(worldFromDriverPose).c_str());
+	#endif
+
+    // Transform used to convert from PSMove Tracking space to OpenVR Tracking Space
+    m_Pose.qWorldFromDriverRotation.w = worldFromDriverPose.Orientation.w;
+    m_Pose.qWorldFromDriverRotation.x = worldFromDriverPose.Orientation.x;
+    m_Pose.qWorldFromDriverRotation.y = worldFromDriverPose.Orientation.y;
+    m_Pose.qWorldFromDriverRotation.z = worldFromDriverPose.Orientation.z;
+    m_Pose.vecWorldFromDriverTranslation[0] = worldFromDriverPose.Position.x;
+    m_Pose.vecWorldFromDriverTranslation[1] = worldFromDriverPose.Position.y;
+    m_Pose.vecWorldFromDriverTranslation[2] = worldFromDriverPose.Position.z;
+}
+
+const char *CPSMoveTrackedDeviceLatest::GetSteamVRIdentifier() const
+{
+    return m_strSteamVRSerialNo.c_str();
+}
+
+//==================================================================================================
+// Pose History
+//==================================================================================================
+
+// Give up on a read after this many collisions with the writer rather than spinning forever
+static const int k_maxPoseHistoryReadAttempts = 8;
+
+CPSMovePoseHistory::CPSMovePoseHistory()
+	: m_writeCount(0)
+	, m_firstReadableIndex(0)
+	, m_nReplacedSampleCount(0)
+	, m_nDroppedSampleCount(0)
+{
+	for (int i = 0; i < k_capacity; ++i)
+	{
+		m_slots[i].sequence.store(0, std::memory_order_relaxed);
+		m_slots[i].writeIndex = 0;
+		memset(&m_slots[i].sample, 0, sizeof(Sample));
+	}
+}
+
+bool CPSMovePoseHistory::AddSample(const Sample &sample)
+{
+	const uint64_t writeCount = m_writeCount.load(std::memory_order_relaxed);
+
+	// Samples have to be in time order for the readers to search them.
+	// A sample stamped with the same time as the newest one replaces it (it's the fresher data),
+	// an older one can't be placed and is counted as dropped.
+	bool bReplaceNewest = false;
+	Sample newestSample;
+	if (GetSample(0, newestSample))
+	{
+		if (sample.timeSeconds < newestSample.timeSeconds)
+		{
+			++m_nDroppedSampleCount;
+			return false;
+		}
+
+		if (sample.timeSeconds == newestSample.timeSeconds)
+		{
+			bReplaceNewest = true;
+			++m_nReplacedSampleCount;
+		}
+	}
 
-void CServerDriver_PSMoveService::HandleFailedToConnectToPSMoveService()
-{
-	DriverLog("CServerDriver_PSMoveService::HandleFailedToConnectToPSMoveService - Called\n");
+	const uint64_t writeIndex = bReplaceNewest ? writeCount - 1 : writeCount;
 
-    // Immediately attempt to reconnect to the service
-    ReconnectToPSMoveService();
-}
+	Slot &slot = m_slots[writeIndex % k_capacity];
+	const uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
 
-void CServerDriver_PSMoveService::HandleDisconnectedFromPSMoveService()
-{
-	DriverLog("CServerDriver_PSMoveService::HandleDisconnectedFromPSMoveService - Called\n");
+	// An odd sequence number tells readers the slot is being rewritten
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
 
-    for (auto it = m_vecTrackedDevices.begin(); it != m_vecTrackedDevices.end(); ++it)
-    {
-        CPSMoveTrackedDeviceLatest *pDevice = *it;
+	slot.writeIndex = writeIndex;
+	slot.sample = sample;
 
-        pDevice->Deactivate();
-    }
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+	if (!bReplaceNewest)
+	{
+		m_writeCount.store(writeIndex + 1, std::memory_order_release);
+	}
 
-    // Immediately attempt to reconnect to the service
-    ReconnectToPSMoveService();
+	return true;
 }
 
-void CServerDriver_PSMoveService::HandleControllerListChanged()
+void CPSMovePoseHistory::Clear()
 {
-	DriverLog("CServerDriver_PSMoveService::HandleControllerListChanged - Called\n");
-
-    // Ask the service for a list of connected controllers
-    // Response handled in HandleControllerListReponse()
-    PSM_GetControllerListAsync(nullptr);
+	m_firstReadableIndex.store(m_writeCount.load(std::memory_order_relaxed), std::memory_order_release);
 }
 
-void CServerDriver_PSMoveService::HandleTrackerListChanged()
+int CPSMovePoseHistory::GetSampleCount() const
 {
-	DriverLog("CServerDriver_PSMoveService::HandleTrackerListChanged - Called\n");
+	const uint64_t writeCount = m_writeCount.load(std::memory_order_acquire);
+	const uint64_t firstReadableIndex = m_firstReadableIndex.load(std::memory_order_acquire);
+	const uint64_t readableCount = (writeCount > firstReadableIndex) ? writeCount - firstReadableIndex : 0;
 
-    // Ask the service for a list of connected trackers
-    // Response handled in HandleTrackerListReponse()
-    PSM_GetTrackerListAsync(nullptr);
-}
-
-// -- Response Handling -----
-void CServerDriver_PSMoveService::HandleClientPSMoveResponse(
-    const PSMMessage *message)
-{	
-    switch (message->response_data.payload_type)
-    {
-    case PSMResponseMessage::_responsePayloadType_Empty:
-        DriverLog("NotifyClientPSMoveResponse - request id %d returned result %s.\n",
-            message->response_data.request_id, 
-            (message->response_data.result_code == PSMResult::PSMResult_Success) ? "ok" : "error");
-        break;
-    case PSMResponseMessage::_responsePayloadType_ControllerList:
-        DriverLog("NotifyClientPSMoveResponse - Controller Count = %d (request id %d).\n", 
-            message->response_data.payload.controller_list.count, message->response_data.request_id);
-        HandleControllerListReponse(&message->response_data.payload.controller_list, message->response_data.opaque_request_handle);
-        break;
-	case PSMResponseMessage::_responsePayloadType_TrackerList:
-        DriverLog("NotifyClientPSMoveResponse - Tracker Count = %d (request id %d).\n",
-            message->response_data.payload.tracker_list.count, message->response_data.request_id);
-        HandleTrackerListReponse(&message->response_data.payload.tracker_list);
-        break;
-    default:
-        DriverLog("NotifyClientPSMoveResponse - Unhandled response (request id %d).\n", message->response_data.request_id);
-    }
+	return static_cast<int>(std::min<uint64_t>(readableCount, k_capacity));
 }
 
-void CServerDriver_PSMoveService::HandleControllerListReponse(
-    const PSMControllerList *controller_list,
-	const PSMResponseHandle response_handle)
+bool CPSMovePoseHistory::ReadSlot(uint64_t writeIndex, Sample &outSample) const
 {
-	DriverLog("CServerDriver_PSMoveService::HandleControllerListReponse - Received %d controllers\n", controller_list->count);
+	const Slot &slot = m_slots[writeIndex % k_capacity];
 
-	bool bAnyNaviControllers= false;
-    for (int list_index = 0; list_index < controller_list->count; ++list_index)
-    {
-        PSMControllerID psmControllerId = controller_list->controller_id[list_index];
-        PSMControllerType psmControllerType = controller_list->controller_type[list_index];
-		std::string psmControllerSerial(controller_list->controller_serial[list_index]);
+	for (int attempt = 0; attempt < k_maxPoseHistoryReadAttempts; ++attempt)
+	{
+		const uint32_t sequenceBefore = slot.sequence.load(std::memory_order_acquire);
+		if ((sequenceBefore & 1) != 0)
+			continue;
 
-        switch (psmControllerType)
-        {
-        case PSMControllerType::PSMController_Move:
-			DriverLog("CServerDriver_PSMoveService::HandleControllerListReponse - Allocate PSMove(%d)\n", psmControllerId);
-            AllocateUniquePSMoveController(psmControllerId, psmControllerSerial);
-            break;
-        case PSMControllerType::PSMController_Navi:
-			// Take care of this is the second pass once all of the PSMove controllers have been setup
-			bAnyNaviControllers= true;
-            break;
-        case PSMControllerType::PSMController_DualShock4:
-			DriverLog("CServerDriver_PSMoveService::HandleControllerListReponse - Allocate PSDualShock4(%d)\n", psmControllerId);
-            AllocateUniqueDualShock4Controller(psmControllerId, psmControllerSerial);
-            break;
-        default:
-            break;
-        }
-    }
+		const uint64_t slotWriteIndex = slot.writeIndex;
+		outSample = slot.sample;
 
-	if (bAnyNaviControllers)
-	{
-		for (int list_index = 0; list_index < controller_list->count; ++list_index)
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) == sequenceBefore)
 		{
-			int controller_id = controller_list->controller_id[list_index];
-			PSMControllerType controller_type = controller_list->controller_type[list_index];
-			std::string ControllerSerial(controller_list->controller_serial[list_index]);
-			std::string ParentControllerSerial(controller_list->parent_controller_serial[list_index]);
-
-			if (controller_type == PSMControllerType::PSMController_Navi)
-			{
-				DriverLog("CServerDriver_PSMoveService::HandleControllerListReponse - Attach PSNavi(%d)\n", controller_id);
-				AttachPSNaviToParentController(controller_id, ControllerSerial, ParentControllerSerial);
-			}
+			// The writer may have lapped us and reused the slot for a newer sample
+			return slotWriteIndex == writeIndex;
 		}
 	}
+
+	return false;
 }
 
-void CServerDriver_PSMoveService::HandleTrackerListReponse(
-    const PSMTrackerList *tracker_list)
+bool CPSMovePoseHistory::GetSample(int age, Sample &outSample) const
 {
-	DriverLog("CServerDriver_PSMoveService::HandleTrackerListReponse - Received %d trackers\n", tracker_list->count);
+	const uint64_t writeCount = m_writeCount.load(std::memory_order_acquire);
 
-    for (int list_index = 0; list_index < tracker_list->count; ++list_index)
-    {
-        const PSMClientTrackerInfo *trackerInfo = &tracker_list->trackers[list_index];
+	if (age < 0 || age >= GetSampleCount())
+		return false;
 
-        AllocateUniquePSMoveTracker(trackerInfo);
-    }
+	return ReadSlot(writeCount - 1 - age, outSample);
 }
 
-void CServerDriver_PSMoveService::SetHMDTrackingSpace(
-    const PSMPosef &origin_pose)
+bool CPSMovePoseHistory::GetLatestAgeSeconds(double nowSeconds, double &outAgeSeconds) const
 {
-	#if LOG_REALIGN_TO_HMD != 0
-		DriverLog("Begin CServerDriver_PSMoveService::SetHMDTrackingSpace()\n");
-	#endif
-
-    m_worldFromDriverPose = origin_pose;
-
-    // Tell all the devices that the relationship between the psmove and the OpenVR
-    // tracking spaces changed
-    for (auto it = m_vecTrackedDevices.begin(); it != m_vecTrackedDevices.end(); ++it)
-    {
-        CPSMoveTrackedDeviceLatest *pDevice = *it;
+	Sample newestSample;
 
-        pDevice->RefreshWorldFromDriverPose();
-    }
-}
+	if (!GetSample(0, newestSample))
+		return false;
 
-static void GenerateControllerSteamVRIdentifier( char *p, int psize, int controller )
-{
-    snprintf(p, psize, "psmove_controller%d", controller);
+	outAgeSeconds = nowSeconds - newestSample.timeSeconds;
+	return true;
 }
 
-void CServerDriver_PSMoveService::AllocateUniquePSMoveController(PSMControllerID psmControllerID, const std::string &psmControllerSerial)
+bool CPSMovePoseHistory::SampleAtTime(double timeSeconds, Sample &outSample) const
 {
-    char svrIdentifier[256];
-    GenerateControllerSteamVRIdentifier(svrIdentifier, sizeof(svrIdentifier), psmControllerID);
+	Sample newer;
+	if (!GetSample(0, newer))
+		return false;
 
-    if ( !FindTrackedDeviceDriver(svrIdentifier) )
-    {	
-		std::string psmSerialNo = psmControllerSerial;
-		std::transform(psmSerialNo.begin(), psmSerialNo.end(), psmSerialNo.begin(), ::toupper);
+	// Don't extrapolate, just hand back the newest sample
+	if (timeSeconds >= newer.timeSeconds)
+	{
+		outSample = newer;
+		return true;
+	}
 
-		if (0 != m_strPSMoveHMDSerialNo.compare(psmSerialNo)) 
+	// Walk back to the pair of samples that bracket the requested time
+	Sample older;
+	for (int age = 1; GetSample(age, older); ++age)
+	{
+		if (older.timeSeconds <= timeSeconds)
 		{
-			DriverLog( "added new psmove controller id: %d, serial: %s\n", psmControllerID, psmSerialNo.c_str());
+			const float t = static_cast<float>((timeSeconds - older.timeSeconds) / (newer.timeSeconds - older.timeSeconds));
 
-            CPSMoveControllerLatest *TrackedDevice= 
-                new CPSMoveControllerLatest( psmControllerID, PSMControllerType::PSMController_Move, psmSerialNo.c_str());
-			m_vecTrackedDevices.push_back(TrackedDevice);
+			outSample.timeSeconds = timeSeconds;
+			outSample.bIsValid = older.bIsValid && newer.bIsValid;
 
-			if (vr::VRServerDriverHost())
+			// lerp the position
+			const PSMVector3f delta = PSM_Vector3fSubtract(&newer.position, &older.position);
+			outSample.position = PSM_Vector3fScaleAndAdd(&delta, t, &older.position);
+
+			// slerp the orientation along the shortest arc
+			const PSMQuatf &a = older.orientation;
+			PSMQuatf b = newer.orientation;
+			float cosHalfAngle = a.w*b.w + a.x*b.x + a.y*b.y + a.z*b.z;
+			if (cosHalfAngle < 0.f)
 			{
-				vr::VRServerDriverHost()->TrackedDeviceAdded(TrackedDevice->GetSteamVRIdentifier(), vr::TrackedDeviceClass_Controller, TrackedDevice);
+				b = PSM_QuatfScale(&b, -1.f);
+				cosHalfAngle = -cosHalfAngle;
 			}
-		}
-		else
-		{
-			DriverLog("skipped new psmove controller as configured for HMD tracking, serial: %s\n", psmSerialNo.c_str());
-		}
-    }
-}
 
+			float weightA = 1.f - t;
+			float weightB = t;
+			if (cosHalfAngle < 0.9995f)
+			{
+				// Far enough apart that lerp would visibly distort the rotation rate
+				const float halfAngle = acosf(cosHalfAngle);
+				const float invSinHalfAngle = 1.f / sinf(halfAngle);
 
-void CServerDriver_PSMoveService::AllocateUniqueDualShock4Controller(PSMControllerID psmControllerID, const std::string &psmControllerSerial)
-{
-    char svrIdentifier[256];
-    GenerateControllerSteamVRIdentifier(svrIdentifier, sizeof(svrIdentifier), psmControllerID);
+				weightA = sinf((1.f - t) * halfAngle) * invSinHalfAngle;
+				weightB = sinf(t * halfAngle) * invSinHalfAngle;
+			}
 
-    if (!FindTrackedDeviceDriver(svrIdentifier))
-    {
-		std::string psmSerialNo = psmControllerSerial;
-		std::transform(psmSerialNo.begin(), psmSerialNo.end(), psmSerialNo.begin(), ::toupper);
+			const PSMQuatf blended = {
+				weightA*a.w + weightB*b.w,
+				weightA*a.x + weightB*b.x,
+				weightA*a.y + weightB*b.y,
+				weightA*a.z + weightB*b.z};
+			outSample.orientation = PSM_QuatfNormalizeWithDefault(&blended, k_psm_quaternion_identity);
 
-		DriverLog( "added new dualshock4 controller id: %d, serial: %s\n", psmControllerID, psmSerialNo.c_str());
+			return true;
+		}
 
-        CPSMoveControllerLatest *TrackedDevice= 
-            new CPSMoveControllerLatest(psmControllerID, PSMControllerType::PSMController_DualShock4, psmSerialNo.c_str());
-		m_vecTrackedDevices.push_back(TrackedDevice);
+		newer = older;
+	}
 
-		if (vr::VRServerDriverHost())
-		{
-			vr::VRServerDriverHost()->TrackedDeviceAdded(TrackedDevice->GetSteamVRIdentifier(), vr::TrackedDeviceClass_Controller, TrackedDevice);
-		}
-    }
+	// Requested time is older than anything we still have
+	return false;
 }
 
-void CServerDriver_PSMoveService::AttachPSNaviToParentController(PSMControllerID NaviControllerID, const std::string &NaviControllerSerial, const std::string &ParentControllerSerial)
-{
-	bool bFoundParent= false;
-
-	std::string naviSerialNo = NaviControllerSerial;
-	std::string parentSerialNo = ParentControllerSerial;
-    std::transform(naviSerialNo.begin(), naviSerialNo.end(), naviSerialNo.begin(), ::toupper);
-	std::transform(parentSerialNo.begin(), parentSerialNo.end(), parentSerialNo.begin(), ::toupper);
+//==================================================================================================
+// Velocity Estimator
+//==================================================================================================
 
-	for (CPSMoveTrackedDeviceLatest *trackedDevice : m_vecTrackedDevices)
-	{
-		if (trackedDevice->GetTrackedDeviceClass() == vr::TrackedDeviceClass_Controller)
-		{
-			CPSMoveControllerLatest *test_controller= static_cast<CPSMoveControllerLatest *>(trackedDevice);
-			const std::string testSerialNo= test_controller->getPSMControllerSerialNo();
-				
-			if (testSerialNo == parentSerialNo)
-			{
-				bFoundParent= true;
+// The rotation vector (axis * angle) of a unit quaternion, taking the shortest path
+static PSMVector3f PSMQuatfToRotationVector(const PSMQuatf &q)
+{
+	const float sign = (q.w < 0.f) ? -1.f : 1.f;
+	const float w = sign * q.w;
+	const PSMVector3f v = {sign * q.x, sign * q.y, sign * q.z};
+	const float sin_half_angle = sqrtf(v.x*v.x + v.y*v.y + v.z*v.z);
 
-				if (test_controller->getPSMControllerType() == PSMController_Move)
-				{
-					if (test_controller->AttachChildPSMController(NaviControllerID, PSMController_Navi, naviSerialNo))
-					{
-						DriverLog("Attached navi controller serial %s to controller serial %s\n", naviSerialNo.c_str(), parentSerialNo.c_str());
-					}
-					else
-					{
-						DriverLog("Failed to attach navi controller serial %s to controller serial %s\n", naviSerialNo.c_str(), parentSerialNo.c_str());
-					}
-				}
-				else
-				{
-					DriverLog("Failed to attach navi controller serial %s to non-psmove controller serial %s\n", naviSerialNo.c_str(), parentSerialNo.c_str());
-				}
+	// 2*atan2(|v|, w) / |v| -> 2 as the angle goes to zero
+	const float scale = (sin_half_angle > 1e-6f) ? 2.f * atan2f(sin_half_angle, w) / sin_half_angle : 2.f;
 
-				break;
-			}
-		}
-	}
+	return PSM_Vector3fScale(&v, scale);
+}
 
-	if (!bFoundParent)
-	{
-		DriverLog("Failed to find parent controller serial %s for navi controller serial %s\n", parentSerialNo.c_str(), naviSerialNo.c_str());
-	}
+CPSMoveVelocityEstimator::CPSMoveVelocityEstimator()
+	: m_windowSize(0)
+{
 }
 
-static void GenerateTrackerSerialNumber(char *p, int psize, int tracker)
+void CPSMoveVelocityEstimator::SetWindowSize(int windowSize)
 {
-    snprintf(p, psize, "psmove_tracker%d", tracker);
+	m_windowSize = std::min(std::max(windowSize, 0), k_maxWindowSize);
 }
 
-void CServerDriver_PSMoveService::AllocateUniquePSMoveTracker(const PSMClientTrackerInfo *trackerInfo)
+bool CPSMoveVelocityEstimator::ComputeVelocities(
+	const CPSMovePoseHistory &history,
+	PSMVector3f &outLinearVelocity, 
+	PSMVector3f &outAngularVelocity) const
 {
-    char svrIdentifier[256];
-    GenerateTrackerSerialNumber(svrIdentifier, sizeof(svrIdentifier), trackerInfo->tracker_id);
+	outLinearVelocity = *k_psm_float_vector3_zero;
+	outAngularVelocity = *k_psm_float_vector3_zero;
+
+	// Grab the newest run of valid samples (don't fit a line across a tracking gap)
+	double sampleTimes[k_maxWindowSize];
+	PSMVector3f samplePositions[k_maxWindowSize];
+	PSMQuatf sampleOrientations[k_maxWindowSize];
+	int sampleCount = 0;
+
+	for (CPSMovePoseHistory::Sample sample; 
+		sampleCount < m_windowSize && history.GetSample(sampleCount, sample) && sample.bIsValid;
+		++sampleCount)
+	{
+		sampleTimes[sampleCount] = sample.timeSeconds;
+		samplePositions[sampleCount] = sample.position;
+		sampleOrientations[sampleCount] = sample.orientation;
+	}
 
-    if (!FindTrackedDeviceDriver(svrIdentifier))
-    {
-        DriverLog("added new tracker device %s\n", svrIdentifier);
-        CPSMoveTrackerLatest *TrackerDevice= new CPSMoveTrackerLatest(trackerInfo);
-        m_vecTrackedDevices.push_back(TrackerDevice);
+	if (sampleCount < 2)
+		return false;
 
-        if (vr::VRServerDriverHost())
-        {
-            vr::VRServerDriverHost()->TrackedDeviceAdded(TrackerDevice->GetSteamVRIdentifier(), vr::TrackedDeviceClass_TrackingReference, TrackerDevice);
-        }
-    }
-}
+	// Fit a line through each channel against time (relative to the newest sample to keep precision).
+	// The slope of the line is the velocity over the window.
+	// Orientations are expressed as the rotation vector from the newest sample to each older one,
+	// which is linear in time for a constant angular velocity.
+	const double newestTime = sampleTimes[0];
+	const PSMQuatf newestOrientationInv = PSM_QuatfConjugate(&sampleOrientations[0]);
 
+	double relativeTimes[k_maxWindowSize];
+	PSMVector3f rotationVectors[k_maxWindowSize];
+	double meanTime = 0.0;
+	PSMVector3f meanPosition = *k_psm_float_vector3_zero;
+	PSMVector3f meanRotation = *k_psm_float_vector3_zero;
 
-// The monitor_psmove is a companion program which can display overlay prompts for us
-// and tell us the pose of the HMD at the moment we want to calibrate.
-void CServerDriver_PSMoveService::LaunchPSMoveMonitor_Internal( const char * pchDriverInstallDir )
-{
-#if LOG_REALIGN_TO_HMD != 0
-	DriverLog("Entered CServerDriver_PSMoveService::LaunchPSMoveMonitor_Internal(%s)\n", pchDriverInstallDir);
-#endif
+	for (int i = 0; i < sampleCount; ++i)
+	{
+		const PSMQuatf &q = sampleOrientations[i];
+		const PSMQuatf &n = newestOrientationInv;
+		const PSMQuatf delta = {
+			q.w*n.w - q.x*n.x - q.y*n.y - q.z*n.z,
+			q.w*n.x + q.x*n.w + q.y*n.z - q.z*n.y,
+			q.w*n.y - q.x*n.z + q.y*n.w + q.z*n.x,
+			q.w*n.z + q.x*n.y - q.y*n.x + q.z*n.w};
+
+		relativeTimes[i] = sampleTimes[i] - newestTime;
+		rotationVectors[i] = PSMQuatfToRotationVector(delta);
+
+		meanTime += relativeTimes[i];
+		meanPosition = PSM_Vector3fAdd(&meanPosition, &samplePositions[i]);
+		meanRotation = PSM_Vector3fAdd(&meanRotation, &rotationVectors[i]);
+	}
 
-    m_bLaunchedPSMoveMonitor = true;
+	const float invCount = 1.f / static_cast<float>(sampleCount);
+	meanTime *= invCount;
+	meanPosition = PSM_Vector3fScale(&meanPosition, invCount);
+	meanRotation = PSM_Vector3fScale(&meanRotation, invCount);
 
-    std::ostringstream path_and_executable_string_builder;
+	double timeVariance = 0.0;
+	double linearCovariance[3] = {0.0, 0.0, 0.0};
+	double angularCovariance[3] = {0.0, 0.0, 0.0};
 
-    path_and_executable_string_builder << pchDriverInstallDir;
-#if defined( _WIN64 )
-    path_and_executable_string_builder << "\\bin\\win64";
-#elif defined( _WIN32 )
-    path_and_executable_string_builder << "\\bin\\win32";
-#elif defined(__APPLE__) 
-    path_and_executable_string_builder << "/bin/osx";
-#else 
-    #error Do not know how to launch psmove_monitor
-#endif
+	for (int i = 0; i < sampleCount; ++i)
+	{
+		const double dt = relativeTimes[i] - meanTime;
+		const PSMVector3f &p = samplePositions[i];
+		const PSMVector3f &r = rotationVectors[i];
+
+		timeVariance += dt * dt;
+		linearCovariance[0] += dt * (p.x - meanPosition.x);
+		linearCovariance[1] += dt * (p.y - meanPosition.y);
+		linearCovariance[2] += dt * (p.z - meanPosition.z);
+		angularCovariance[0] += dt * (r.x - meanRotation.x);
+		angularCovariance[1] += dt * (r.y - meanRotation.y);
+		angularCovariance[2] += dt * (r.z - meanRotation.z);
+	}
 
+	if (timeVariance <= 1e-12)
+		return false;
 
-#if defined( _WIN32 ) || defined( _WIN64 )
-	path_and_executable_string_builder << "\\monitor_psmove.exe";
-	const std::string monitor_path_and_exe = path_and_executable_string_builder.str();
+	outLinearVelocity.x = static_cast<float>(linearCovariance[0] / timeVariance);
+	outLinearVelocity.y = static_cast<float>(linearCovariance[1] / timeVariance);
+	outLinearVelocity.z = static_cast<float>(linearCovariance[2] / timeVariance);
+	outAngularVelocity.x = static_cast<float>(angularCovariance[0] / timeVariance);
+	outAngularVelocity.y = static_cast<float>(angularCovariance[1] / timeVariance);
+	outAngularVelocity.z = static_cast<float>(angularCovariance[2] / timeVariance);
 
-	std::ostringstream args_string_builder;
-	args_string_builder << "monitor_psmove.exe \"" << pchDriverInstallDir << "\\resources\"";
-	const std::string monitor_args = args_string_builder.str();
-	
-	char monitor_args_cstr[1024];
-	strncpy_s(monitor_args_cstr, monitor_args.c_str(), sizeof(monitor_args_cstr) - 1);
-	monitor_args_cstr[sizeof(monitor_args_cstr) - 1] = '\0';
+	return true;
+}
 
-	#if LOG_REALIGN_TO_HMD != 0
-		DriverLog("CServerDriver_PSMoveService::LaunchPSMoveMonitor_Internal() monitor_psmove windows full path: %s\n", monitor_path_and_exe.c_str());
-		DriverLog("CServerDriver_PSMoveService::LaunchPSMoveMonitor_Internal() monitor_psmove windows args: %s\n", monitor_args_cstr);
-	#endif
+//==================================================================================================
+// Pose Jitter Filter
+//==================================================================================================
 
-	STARTUPINFOA sInfoProcess = { 0 };
-	sInfoProcess.cb = sizeof(STARTUPINFOW);
-	PROCESS_INFORMATION pInfoStartedProcess;
-	BOOL bSuccess = CreateProcessA(monitor_path_and_exe.c_str(), monitor_args_cstr, NULL, NULL, FALSE, 0, NULL, NULL, &sInfoProcess, &pInfoStartedProcess);
-	DWORD ErrorCode = (bSuccess == TRUE) ? 0 : GetLastError();
+// Time constant of a first order low pass filter, which is also its lag at low frequencies
+static inline float LowPassTimeConstant(float cutoffHz)
+{
+	return 1.f / (2.f * static_cast<float>(M_PI) * cutoffHz);
+}
 
-	DriverLog("CServerDriver_PSMoveService::LaunchPSMoveMonitor_Internal() Start monitor_psmove CreateProcessA() result: %d.\n", ErrorCode);
+static inline float LowPassAlpha(float cutoffHz, float dt)
+{
+	return 1.f / (1.f + LowPassTimeConstant(cutoffHz) / dt);
+}
 
-#elif defined(__APPLE__) 
-    pid_t processId;
-    if ((processId = fork()) == 0)
-    {
-		path_and_executable_string_builder << "\\monitor_psmove";
+CPSMovePoseJitterFilter::CPSMovePoseJitterFilter()
+	: m_bEnabled(false)
+	, m_minCutoffHz(k_defaultJitterFilterMinCutoffHz)
+	, m_positionBeta(k_defaultJitterFilterPositionBeta)
+	, m_rotationBeta(k_defaultJitterFilterRotationBeta)
+	, m_derivativeCutoffHz(k_defaultJitterFilterDerivativeCutoffHz)
+	, m_bHasPreviousSample(false)
+	, m_previousTimeSeconds(0.0)
+	, m_filteredPosition(*k_psm_float_vector3_zero)
+	, m_filteredOrientation(*k_psm_quaternion_identity)
+	, m_filteredLinearSpeed(0.f)
+	, m_filteredAngularSpeed(0.f)
+	, m_lastPositionLagSeconds(0.0)
+	, m_lastRotationLagSeconds(0.0)
+	, m_positionLagSumSeconds(0.0)
+	, m_rotationLagSumSeconds(0.0)
+	, m_filteredSampleCount(0)
+{
+}
 
-		const std::string monitor_exe_path = path_and_executable_string_builder.str();
-        const char * argv[] = { monitor_exe_path.c_str(), pchDriverInstallDir, NULL };
-        
-        if (execv(app, argv) < 0)
-        {
-            DriverLog( "Failed to exec child process\n");
-        }
-    }
-    else if (processId < 0)
-    {
-        DriverLog( "Failed to fork child process\n");
-        perror("fork error");
-    }
-#else 
-#error Do not know how to launch psmove config tool
-#endif
+void CPSMovePoseJitterFilter::SetParameters(
+	float minCutoffHz, 
+	float positionBeta, 
+	float rotationBeta, 
+	float derivativeCutoffHz)
+{
+	// Cutoffs must stay positive or the time constant blows up
+	m_minCutoffHz = fmaxf(minCutoffHz, 0.01f);
+	m_positionBeta = fmaxf(positionBeta, 0.f);
+	m_rotationBeta = fmaxf(rotationBeta, 0.f);
+	m_derivativeCutoffHz = fmaxf(derivativeCutoffHz, 0.01f);
+	Reset();
 }
 
-/** Launch monitor_psmove if needed (requested by devices as they activate) */
-void CServerDriver_PSMoveService::LaunchPSMoveMonitor()
+void CPSMovePoseJitterFilter::Reset()
 {
-    if ( m_bLaunchedPSMoveMonitor )
+	m_bHasPreviousSample = false;
+	m_filteredLinearSpeed = 0.f;
+	m_filteredAngularSpeed = 0.f;
+}
+
+double CPSMovePoseJitterFilter::GetAveragePositionLagSeconds() const
+{
+	return (m_filteredSampleCount > 0) ? m_positionLagSumSeconds / static_cast<double>(m_filteredSampleCount) : 0.0;
+}
+
+double CPSMovePoseJitterFilter::GetAverageRotationLagSeconds() const
+{
+	return (m_filteredSampleCount > 0) ? m_rotationLagSumSeconds / static_cast<double>(m_filteredSampleCount) : 0.0;
+}
+
+void CPSMovePoseJitterFilter::Apply(
+	double timeSeconds, 
+	PSMVector3f &inOutPosition, 
+	PSMQuatf &inOutOrientation)
+{
+	if (!m_bEnabled)
+		return;
+
+	if (!m_bHasPreviousSample)
 	{
-        return;
+		// Nothing to smooth against yet
+		m_filteredPosition = inOutPosition;
+		m_filteredOrientation = inOutOrientation;
+		m_previousTimeSeconds = timeSeconds;
+		m_bHasPreviousSample = true;
+		return;
 	}
 
-	#if LOG_REALIGN_TO_HMD != 0
-	DriverLog("CServerDriver_PSMoveService::LaunchPSMoveMonitor() - Called\n");
-	#endif
+	const float dt = static_cast<float>(timeSeconds - m_previousTimeSeconds);
+	if (dt <= 0.f)
+	{
+		// Same sample again, hand back what we already produced for it
+		inOutPosition = m_filteredPosition;
+		inOutOrientation = m_filteredOrientation;
+		return;
+	}
+	m_previousTimeSeconds = timeSeconds;
 
-    //###HipsterSloth $TODO - Ideally we would get the install path as a property, but this property fetch doesn't seem to work...
-	//vr::ETrackedPropertyError errorCode;
-	//std::string driverInstallDir= vr::VRProperties()->GetStringProperty(requestingDevicePropertyHandle, vr::Prop_InstallPath_String, &errorCode);
+	// Position: low pass the speed, then use it to pick the cutoff for the position itself
+	{
+		const PSMVector3f delta = PSM_Vector3fSubtract(&inOutPosition, &m_filteredPosition);
+		const float speed = PSM_Vector3fLength(&delta) / dt;
+		m_filteredLinearSpeed += LowPassAlpha(m_derivativeCutoffHz, dt) * (speed - m_filteredLinearSpeed);
 
-    //...so for now, just assume that we're running out of the steamvr folder
-    char szCurrentDirectory[MAX_PATH];
-    if (getcwd(szCurrentDirectory, MAX_PATH - 1) != 0)
-    {
-        DriverLog("CServerDriver_PSMoveService::LaunchPSMoveMonitor() - vrserver working directory: %s\n", szCurrentDirectory);
+		const float cutoffHz = m_minCutoffHz + m_positionBeta * m_filteredLinearSpeed;
+		const float alpha = LowPassAlpha(cutoffHz, dt);
 
-	    std::ostringstream driverInstallDirBuilder;
-        driverInstallDirBuilder << szCurrentDirectory;
-        #if defined( _WIN64 ) || defined( _WIN32 )
-            driverInstallDirBuilder << "\\drivers\\psmove";
-        #else
-            driverInstallDirBuilder << "/drivers/psmove";
-        #endif
-	    const std::string driverInstallDir = driverInstallDirBuilder.str();
+		m_filteredPosition = PSM_Vector3fScaleAndAdd(&delta, alpha, &m_filteredPosition);
+		m_lastPositionLagSeconds = LowPassTimeConstant(cutoffHz);
+	}
 
-	    LaunchPSMoveMonitor_Internal( driverInstallDir.c_str() );
-    }
-    else
-    {
-        DriverLog("CServerDriver_PSMoveService::LaunchPSMoveMonitor() - Failed to fetch current directory\n");
-    }
+	// Orientation: same scheme with the angular speed, blending along the shortest arc
+	{
+		const PSMQuatf &q = inOutOrientation;
+		const PSMQuatf &f = m_filteredOrientation;
+		float dot = q.w*f.w + q.x*f.x + q.y*f.y + q.z*f.z;
+		const float sign = (dot < 0.f) ? -1.f : 1.f;
+		dot = fminf(dot * sign, 1.f);
+
+		const float speed = 2.f * acosf(dot) / dt;
+		m_filteredAngularSpeed += LowPassAlpha(m_derivativeCutoffHz, dt) * (speed - m_filteredAngularSpeed);
+
+		const float cutoffHz = m_minCutoffHz + m_rotationBeta * m_filteredAngularSpeed;
+		const float alpha = LowPassAlpha(cutoffHz, dt);
+
+		// nlerp is plenty accurate for the small per sample steps involved here
+		PSMQuatf blended = {
+			f.w + alpha * (sign * q.w - f.w),
+			f.x + alpha * (sign * q.x - f.x),
+			f.y + alpha * (sign * q.y - f.y),
+			f.z + alpha * (sign * q.z - f.z)};
+		m_filteredOrientation = PSM_QuatfNormalizeWithDefault(&blended, k_psm_quaternion_identity);
+		m_lastRotationLagSeconds = LowPassTimeConstant(cutoffHz);
+	}
+
+	m_positionLagSumSeconds += m_lastPositionLagSeconds;
+	m_rotationLagSumSeconds += m_lastRotationLagSeconds;
+	++m_filteredSampleCount;
+
+	inOutPosition = m_filteredPosition;
+	inOutOrientation = m_filteredOrientation;
 }
 
 //==================================================================================================
-// Tracked Device Driver
+// Stationary Detector
 //==================================================================================================
 
-CPSMoveTrackedDeviceLatest::CPSMoveTrackedDeviceLatest()
-    : m_ulPropertyContainer(vr::k_ulInvalidPropertyContainer)
-    , m_unSteamVRTrackedDeviceId(vr::k_unTrackedDeviceIndexInvalid)
+CPSMoveStationaryDetector::CPSMoveStationaryDetector()
+	: m_bEnabled(false)
+	, m_linearSpeedThreshold(k_defaultStationaryLinearSpeedThreshold)
+	, m_angularSpeedThreshold(k_defaultStationaryAngularSpeedThreshold)
+	, m_positionTolerance(k_defaultStationaryPositionToleranceMillimeters / 1000.f)
+	, m_angleTolerance(k_defaultStationaryAngleToleranceDegrees / k_fRadiansToDegrees)
+	, m_settleTimeSeconds(k_defaultStationarySettleTimeMilliseconds / 1000.f)
+	, m_bHasAnchor(false)
+	, m_bIsStationary(false)
+	, m_anchorTimeSeconds(0.0)
+	, m_anchorPosition(*k_psm_float_vector3_zero)
+	, m_anchorOrientation(*k_psm_quaternion_identity)
+	, m_nStationaryEntryCount(0)
 {
-    memset(&m_Pose, 0, sizeof(m_Pose));
-    m_Pose.result = vr::TrackingResult_Uninitialized;
-
-    // By default, assume that the tracked devices are in the tracking space as OpenVR
-    m_Pose.qWorldFromDriverRotation.w = 1.f;
-    m_Pose.qWorldFromDriverRotation.x = 0.f;
-    m_Pose.qWorldFromDriverRotation.y = 0.f;
-    m_Pose.qWorldFromDriverRotation.z = 0.f;
-    m_Pose.vecWorldFromDriverTranslation[0] = 0.f;
-    m_Pose.vecWorldFromDriverTranslation[1] = 0.f;
-    m_Pose.vecWorldFromDriverTranslation[2] = 0.f;
-
-    m_firmware_revision = 0x0001;
-    m_hardware_revision = 0x0001;
+}
 
-	m_lastHMDPoseInMeters= *k_psm_pose_identity;
-	m_lastHMDPoseTime= std::chrono::time_point<std::chrono::high_resolution_clock>();
-	m_bIsLastHMDPoseValid= false;
-	m_hmdResultCallback = nullptr;
-	m_hmdResultUserData = nullptr;
+void CPSMoveStationaryDetector::SetParameters(
+	float linearSpeedThreshold, 
+	float angularSpeedThreshold, 
+	float positionTolerance, 
+	float angleTolerance, 
+	float settleTimeSeconds)
+{
+	m_linearSpeedThreshold = fmaxf(linearSpeedThreshold, 0.f);
+	m_angularSpeedThreshold = fmaxf(angularSpeedThreshold, 0.f);
+	m_positionTolerance = fmaxf(positionTolerance, 0.f);
+	m_angleTolerance = fmaxf(angleTolerance, 0.f);
+	m_settleTimeSeconds = fmaxf(settleTimeSeconds, 0.f);
+	Reset();
 }
 
-CPSMoveTrackedDeviceLatest::~CPSMoveTrackedDeviceLatest()
+void CPSMoveStationaryDetector::Reset()
 {
+	m_bHasAnchor = false;
+	m_bIsStationary = false;
 }
 
-// Shared Implementation of vr::ITrackedDeviceServerDriver
-vr::EVRInitError CPSMoveTrackedDeviceLatest::Activate(vr::TrackedDeviceIndex_t unObjectId)
+bool CPSMoveStationaryDetector::Update(
+	double timeSeconds, 
+	const PSMVector3f &position, 
+	const PSMQuatf &orientation, 
+	float linearSpeed, 
+	float angularSpeed)
 {
-	vr::CVRPropertyHelpers *properties= vr::VRProperties();
+	if (!m_bEnabled)
+		return false;
 
-    DriverLog("CPSMoveTrackedDeviceLatest::Activate: %s is object id %d\n", GetSteamVRIdentifier(), unObjectId);
-	m_ulPropertyContainer = properties->TrackedDeviceToPropertyContainer( unObjectId );
-    m_unSteamVRTrackedDeviceId = unObjectId;
+	const bool bIsSlow = linearSpeed <= m_linearSpeedThreshold && angularSpeed <= m_angularSpeedThreshold;
+	bool bIsNearAnchor = false;
 
-	properties->SetBoolProperty(m_ulPropertyContainer, vr::Prop_Firmware_UpdateAvailable_Bool, false);
-	properties->SetBoolProperty(m_ulPropertyContainer, vr::Prop_Firmware_ManualUpdate_Bool, false);
-	properties->SetBoolProperty(m_ulPropertyContainer, vr::Prop_ContainsProximitySensor_Bool, false);
-	properties->SetBoolProperty(m_ulPropertyContainer, vr::Prop_HasCamera_Bool, false);
-	properties->SetBoolProperty(m_ulPropertyContainer, vr::Prop_Firmware_ForceUpdateRequired_Bool, false);
-	properties->SetBoolProperty(m_ulPropertyContainer, vr::Prop_DeviceCanPowerOff_Bool, false);
-	properties->SetUint64Property(m_ulPropertyContainer, vr::Prop_HardwareRevision_Uint64, m_hardware_revision);
-	properties->SetUint64Property(m_ulPropertyContainer, vr::Prop_FirmwareVersion_Uint64, m_firmware_revision);
+	// The velocity thresholds alone would let a slow drift accumulate, so also check how far
+	// the controller has moved from where it came to rest
+	if (m_bHasAnchor)
+	{
+		const PSMVector3f offset = PSM_Vector3fSubtract(&position, &m_anchorPosition);
+		const PSMQuatf &q = orientation;
+		const PSMQuatf &a = m_anchorOrientation;
+		const float cosHalfAngle = fminf(fabsf(q.w*a.w + q.x*a.x + q.y*a.y + q.z*a.z), 1.f);
+
+		bIsNearAnchor = 
+			PSM_Vector3fLength(&offset) <= m_positionTolerance &&
+			2.f * acosf(cosHalfAngle) <= m_angleTolerance;
+	}
 
-    return vr::VRInitError_None;
+	if (bIsSlow && bIsNearAnchor)
+	{
+		if (!m_bIsStationary && timeSeconds - m_anchorTimeSeconds >= m_settleTimeSeconds)
+		{
+			m_bIsStationary = true;
+			++m_nStationaryEntryCount;
+		}
+	}
+	else
+	{
+		// Significant motion: back to full rate, and start looking for a new rest pose from here
+		m_bIsStationary = false;
+		m_bHasAnchor = true;
+		m_anchorTimeSeconds = timeSeconds;
+		m_anchorPosition = position;
+		m_anchorOrientation = orientation;
+	}
+
+	return m_bIsStationary;
 }
 
-void CPSMoveTrackedDeviceLatest::Deactivate() 
+//==================================================================================================
+// Axis Event Filter
+//==================================================================================================
+
+CPSMoveAxisEventFilter::CPSMoveAxisEventFilter()
+	: m_quantizationSteps(0.f)
+	, m_deadband(0.f)
+	, m_minEventIntervalSeconds(0.0)
+	, m_nSentEventCount(0)
+	, m_nDeadbandSuppressedCount(0)
+	, m_nRateSuppressedCount(0)
 {
-    DriverLog("CPSMoveTrackedDeviceLatest::Deactivate: %s was object id %d\n", GetSteamVRIdentifier(), m_unSteamVRTrackedDeviceId);
-    m_unSteamVRTrackedDeviceId = vr::k_unTrackedDeviceIndexInvalid;
+	Reset();
 }
 
-void CPSMoveTrackedDeviceLatest::EnterStandby()
+void CPSMoveAxisEventFilter::SetParameters(
+	int quantizationSteps, 
+	float deadband, 
+	float maxEventRateHz)
 {
-    //###HipsterSloth $TODO - No good way to do this at the moment
+	m_quantizationSteps = static_cast<float>(std::max(quantizationSteps, 0));
+	m_deadband = fmaxf(deadband, 0.f);
+	m_minEventIntervalSeconds = 
+		(maxEventRateHz > 0.f) 
+		? 1.0 / fminf(maxEventRateHz, k_maxAxisEventRateHz) 
+		: 0.0;
+	Reset();
 }
 
-void *CPSMoveTrackedDeviceLatest::GetComponent(const char *pchComponentNameAndVersion)
+void CPSMoveAxisEventFilter::Reset()
 {
-    return NULL;
+	// vrserver starts out with all axes at rest
+	for (uint32_t axisIndex = 0; axisIndex < vr::k_unControllerStateAxisCount; ++axisIndex)
+	{
+		m_lastSentAxis[axisIndex].x = 0.f;
+		m_lastSentAxis[axisIndex].y = 0.f;
+		m_lastSentTimeSeconds[axisIndex] = 0.0;
+	}
 }
 
-void CPSMoveTrackedDeviceLatest::DebugRequest(
-    const char * pchRequest,
-    char * pchResponseBuffer,
-    uint32_t unResponseBufferSize)
+static inline bool IsAxisValueAtRestOrEndStop(float value)
 {
-	std::istringstream ss( pchRequest );
-	std::string strCmd;
+	return value == 0.f || value == 1.f || value == -1.f;
+}
 
-	ss >> strCmd;
-	if (strCmd == "psmove:hmd_pose")
-	{
-		#if LOG_REALIGN_TO_HMD != 0
-			DriverLog( "CPSMoveTrackedDeviceLatest::DebugRequest(): %s\n", strCmd.c_str() );
-		#endif
+bool CPSMoveAxisEventFilter::FilterAxis(
+	uint32_t axisIndex, 
+	vr::VRControllerAxis_t &axis, 
+	double timeSeconds)
+{
+	assert(axisIndex < vr::k_unControllerStateAxisCount);
+	vr::VRControllerAxis_t &lastSent = m_lastSentAxis[axisIndex];
 
-		// monitor_psmove is calling us back with HMD tracking information
-		vr::HmdMatrix34_t hmdTransform;
+	if (m_quantizationSteps > 0.f)
+	{
+		axis.x = roundf(axis.x * m_quantizationSteps) / m_quantizationSteps;
+		axis.y = roundf(axis.y * m_quantizationSteps) / m_quantizationSteps;
+	}
 
+	if (axis.x == lastSent.x && axis.y == lastSent.y)
+		return false;
 
-		#if LOG_REALIGN_TO_HMD != 0
-			std::ostringstream matrixStringBuilder;
-			matrixStringBuilder << "hmdTransform.m:\n\t";
-		#endif
+	// Always let the input settle exactly at rest or at an end stop
+	const bool bIsExactValue = 
+		(axis.x != lastSent.x && IsAxisValueAtRestOrEndStop(axis.x)) ||
+		(axis.y != lastSent.y && IsAxisValueAtRestOrEndStop(axis.y));
 
-		for (int i = 0; i < 3; ++i)
+	if (!bIsExactValue)
+	{
+		if (fabsf(axis.x - lastSent.x) <= m_deadband && fabsf(axis.y - lastSent.y) <= m_deadband)
 		{
-			for (int j = 0; j < 4; ++j)
-			{
-				ss >> hmdTransform.m[i][j];
-				#if LOG_REALIGN_TO_HMD != 0
-					matrixStringBuilder << "[" << hmdTransform.m[i][j] << "] ";
-				#endif
-			}
-			#if LOG_REALIGN_TO_HMD != 0
-				matrixStringBuilder << "\n\t";
-			#endif
+			axis = lastSent;
+			++m_nDeadbandSuppressedCount;
+			return false;
 		}
 
-		m_lastHMDPoseInMeters = openvrMatrixExtractPSMPosef(hmdTransform);
+		if (timeSeconds - m_lastSentTimeSeconds[axisIndex] < m_minEventIntervalSeconds)
+		{
+			axis = lastSent;
+			++m_nRateSuppressedCount;
+			return false;
+		}
+	}
 
-		#if LOG_REALIGN_TO_HMD != 0
-			matrixStringBuilder << "\n";
-			DriverLog(matrixStringBuilder.str().c_str());
+	lastSent = axis;
+	m_lastSentTimeSeconds[axisIndex] = timeSeconds;
+	++m_nSentEventCount;
 
-			DriverLog("Extracted pose: %s \n", PSMPosefToString(m_lastHMDPoseInMeters).c_str() );
-		#endif
+	return true;
+}
 
-		m_lastHMDPoseTime = std::chrono::high_resolution_clock::now();
+//==================================================================================================
+// Analog Stage
+//==================================================================================================
 
-		if (m_hmdResultCallback != nullptr)
-		{
-			m_hmdResultCallback(m_lastHMDPoseInMeters, m_hmdResultUserData);
-			m_hmdResultCallback = nullptr;
-			m_hmdResultUserData = nullptr;
-		}
-	}
+CPSMoveAnalogStage::CPSMoveAnalogStage()
+	: m_stickDeadzone(k_defaultThumbstickDeadZoneRadius)
+	, m_triggerDeadzone(0.f)
+	, m_triggerTouchThreshold(k_defaultTriggerTouchThreshold)
+	, m_triggerPressThreshold(k_defaultTriggerPressThreshold)
+	, m_triggerHysteresis(k_defaultTriggerHysteresis)
+{
+	BuildResponseCurve(1.f, m_stickResponseCurve);
+	BuildResponseCurve(1.f, m_triggerResponseCurve);
+	Reset();
 }
 
-void CPSMoveTrackedDeviceLatest::RequestLatestHMDPose(
-	float maxPoseAgeMilliseconds,
-	CPSMoveTrackedDeviceLatest::t_hmd_request_callback callback,
-	void *userdata)
+void CPSMoveAnalogStage::SetStickParameters(
+	float deadzoneRadius, 
+	float curveExponent)
 {
-	#if LOG_REALIGN_TO_HMD != 0
-		DriverLog("Begin CPSMoveTrackedDeviceLatest::RequestLatestHMDPose()\n");
-	#endif
+	m_stickDeadzone = fminf(fmaxf(deadzoneRadius, 0.f), 0.99f);
+	BuildResponseCurve(curveExponent, m_stickResponseCurve);
+}
 
-	assert(m_hmdResultCallback == nullptr || m_hmdResultCallback == callback);
+void CPSMoveAnalogStage::SetTriggerParameters(
+	float deadzone, 
+	float curveExponent, 
+	float touchThreshold, 
+	float pressThreshold, 
+	float hysteresis)
+{
+	m_triggerDeadzone = fminf(fmaxf(deadzone, 0.f), 0.99f);
+	BuildResponseCurve(curveExponent, m_triggerResponseCurve);
+	m_triggerTouchThreshold = fminf(fmaxf(touchThreshold, 0.f), 1.f);
+	m_triggerPressThreshold = fminf(fmaxf(pressThreshold, m_triggerTouchThreshold), 1.f);
+	m_triggerHysteresis = fminf(fmaxf(hysteresis, 0.f), m_triggerTouchThreshold);
+	Reset();
+}
 
-	if (m_hmdResultCallback == nullptr)
+void CPSMoveAnalogStage::Reset()
+{
+	for (int triggerIndex = 0; triggerIndex < k_maxTriggers; ++triggerIndex)
 	{
-		bool bUsedCachedHMDPose;
-
-		if (m_bIsLastHMDPoseValid)
-		{
-			std::chrono::duration<float, std::milli> hmdPoseAge =
-				std::chrono::high_resolution_clock::now() - m_lastHMDPoseTime;
+		m_bTriggerTouched[triggerIndex] = false;
+		m_bTriggerPressed[triggerIndex] = false;
+	}
+}
 
-			bUsedCachedHMDPose = hmdPoseAge.count() < maxPoseAgeMilliseconds;
-		}
-		else
-		{
-			bUsedCachedHMDPose = false;
-		}
+void CPSMoveAnalogStage::BuildResponseCurve(float exponent, float *curve)
+{
+	exponent = fminf(fmaxf(exponent, k_minResponseCurveExponent), k_maxResponseCurveExponent);
 
-		if (bUsedCachedHMDPose)
-		{
-			// Give the callback the cached pose immediately
-			if (callback != nullptr)
-			{
-				callback(m_lastHMDPoseInMeters, userdata);
-			}
-		}
-		else
-		{
-			static vr::VREvent_Data_t nodata = { 0 };
+	for (int sampleIndex = 0; sampleIndex <= k_responseCurveSegments; ++sampleIndex)
+	{
+		curve[sampleIndex] = powf(static_cast<float>(sampleIndex) / k_responseCurveSegments, exponent);
+	}
+}
 
-			// Register the callback
-			m_hmdResultCallback = callback;
-			m_hmdResultUserData = userdata;
+float CPSMoveAnalogStage::EvaluateResponseCurve(const float *curve, float value)
+{
+	// value is in [0, 1]. Interpolate between the two nearest samples.
+	const float position = value * k_responseCurveSegments;
+	const int sampleIndex = std::min(static_cast<int>(position), k_responseCurveSegments - 1);
+	const float fraction = position - static_cast<float>(sampleIndex);
 
-			// Ask monitor_psmove to tell us the latest HMD pose
-			vr::VRServerDriverHost()->VendorSpecificEvent(
-				m_unSteamVRTrackedDeviceId,
-				(vr::EVREventType) (vr::VREvent_VendorSpecific_Reserved_Start + 0),
-				nodata,
-				0);
-		}
-	}
+	return curve[sampleIndex] + (curve[sampleIndex + 1] - curve[sampleIndex]) * fraction;
 }
 
-vr::DriverPose_t CPSMoveTrackedDeviceLatest::GetPose()
+bool CPSMoveAnalogStage::ProcessStick(float &x, float &y) const
 {
-    // This is only called at startup to synchronize with the driver.
-    // Future updates are driven by our thread calling TrackedDevicePoseUpdated()
-    return m_Pose;
+	const float radius = sqrtf(x*x + y*y);
+
+	if (radius <= 0.f || radius < m_stickDeadzone)
+	{
+		x = 0.f;
+		y = 0.f;
+		return false;
+	}
+
+	// Rescale the radius to hide the dead zone, then shape it. The direction is left untouched.
+	const float rescaledRadius = fminf((radius - m_stickDeadzone) / (1.f - m_stickDeadzone), 1.f);
+	const float scale = EvaluateResponseCurve(m_stickResponseCurve, rescaledRadius) / radius;
+
+	x *= scale;
+	y *= scale;
+
+	return true;
 }
 
-// CPSMoveTrackedDeviceLatest Interface
-vr::ETrackedDeviceClass CPSMoveTrackedDeviceLatest::GetTrackedDeviceClass() const
+float CPSMoveAnalogStage::ProcessTrigger(int triggerIndex, float value)
 {
-    return vr::TrackedDeviceClass_Invalid;
+	assert(triggerIndex >= 0 && triggerIndex < k_maxTriggers);
+
+	value = fminf(fmaxf(value, 0.f), 1.f);
+
+	const float shapedValue = 
+		(value > m_triggerDeadzone) 
+		? EvaluateResponseCurve(m_triggerResponseCurve, (value - m_triggerDeadzone) / (1.f - m_triggerDeadzone)) 
+		: 0.f;
+
+	bool &bTouched = m_bTriggerTouched[triggerIndex];
+	if (!bTouched && shapedValue > m_triggerTouchThreshold)
+		bTouched = true;
+	else if (bTouched && shapedValue <= m_triggerTouchThreshold - m_triggerHysteresis)
+		bTouched = false;
+
+	bool &bPressed = m_bTriggerPressed[triggerIndex];
+	if (!bPressed && shapedValue > m_triggerPressThreshold)
+		bPressed = true;
+	else if (bPressed && shapedValue <= m_triggerPressThreshold - m_triggerHysteresis)
+		bPressed = false;
+
+	return shapedValue;
 }
 
-bool CPSMoveTrackedDeviceLatest::IsActivated() const
+//==================================================================================================
+// Gesture Engine
+//==================================================================================================
+
+CPSMoveGestureEngine::CPSMoveGestureEngine()
 {
-    return m_unSteamVRTrackedDeviceId != vr::k_unTrackedDeviceIndexInvalid;
+	Clear();
 }
 
-void CPSMoveTrackedDeviceLatest::Update()
+void CPSMoveGestureEngine::Clear()
 {
+	m_gestureCount = 0;
+
+	for (int actionIndex = 0; actionIndex < k_EGestureAction_Count; ++actionIndex)
+	{
+		m_nFiredCount[actionIndex] = 0;
+	}
 }
 
-void CPSMoveTrackedDeviceLatest::RefreshWorldFromDriverPose()
+bool CPSMoveGestureEngine::AddGesture(
+	eGestureAction action, 
+	eGestureRequirement requirement, 
+	const GestureButton *buttons, 
+	int buttonCount, 
+	float holdSeconds)
 {
-	#if LOG_REALIGN_TO_HMD != 0
-		DriverLog( "Begin CServerDriver_PSMoveService::RefreshWorldFromDriverPose() for device %s\n", GetSteamVRIdentifier() );
-	#endif
+	if (m_gestureCount >= k_maxGestures || buttonCount <= 0 || buttonCount > k_maxGestureButtons)
+		return false;
 
-    const PSMPosef worldFromDriverPose = g_ServerTrackedDeviceProvider.GetWorldFromDriverPose();
+	Gesture &gesture = m_gestures[m_gestureCount++];
 
-	#if LOG_REALIGN_TO_HMD != 0
-		DriverLog("worldFromDriverPose: %s \n", PSMPosefToString(worldFromDriverPose).c_str());
-	#endif
+	gesture.action = action;
+	gesture.requirement = requirement;
+	for (int buttonIndex = 0; buttonIndex < buttonCount; ++buttonIndex)
+	{
+		gesture.buttons[buttonIndex] = buttons[buttonIndex];
+	}
+	gesture.buttonCount = buttonCount;
+	gesture.holdSeconds = fmaxf(holdSeconds, 0.f);
+	gesture.bIsHeld = false;
+	gesture.bHasFired = false;
+	gesture.heldSinceSeconds = 0.0;
 
-    // Transform used to convert from PSMove Tracking space to OpenVR Tracking Space
-    m_Pose.qWorldFromDriverRotation.w = worldFromDriverPose.Orientation.w;
-    m_Pose.qWorldFromDriverRotation.x = worldFromDriverPose.Orientation.x;
-    m_Pose.qWorldFromDriverRotation.y = worldFromDriverPose.Orientation.y;
-    m_Pose.qWorldFromDriverRotation.z = worldFromDriverPose.Orientation.z;
-    m_Pose.vecWorldFromDriverTranslation[0] = worldFromDriverPose.Position.x;
-    m_Pose.vecWorldFromDriverTranslation[1] = worldFromDriverPose.Position.y;
-    m_Pose.vecWorldFromDriverTranslation[2] = worldFromDriverPose.Position.z;
+	return true;
 }
 
-const char *CPSMoveTrackedDeviceLatest::GetSteamVRIdentifier() const
+CPSMoveGestureEngine::eGestureAction CPSMoveGestureEngine::Update(
+	const PSMController *view, 
+	const PSMController *childView, 
+	double timeSeconds)
 {
-    return m_strSteamVRSerialNo.c_str();
+	eGestureAction firedAction = k_EGestureAction_None;
+
+	for (int gestureIndex = 0; gestureIndex < m_gestureCount; ++gestureIndex)
+	{
+		Gesture &gesture = m_gestures[gestureIndex];
+
+		bool bAllButtonsHeld;
+		switch (gesture.requirement)
+		{
+		case k_EGestureRequirement_NoChildController:
+			bAllButtonsHeld = childView == nullptr;
+			break;
+		case k_EGestureRequirement_ChildController:
+			bAllButtonsHeld = childView != nullptr;
+			break;
+		default:
+			bAllButtonsHeld = true;
+			break;
+		}
+
+		for (int buttonIndex = 0; bAllButtonsHeld && buttonIndex < gesture.buttonCount; ++buttonIndex)
+		{
+			const GestureButton &button = gesture.buttons[buttonIndex];
+			const PSMController *buttonView = button.bIsChildButton ? childView : view;
+
+			if (buttonView != nullptr)
+			{
+				const uint8_t *stateBase = reinterpret_cast<const uint8_t *>(&buttonView->ControllerState);
+				const PSMButtonState buttonState = *reinterpret_cast<const PSMButtonState *>(stateBase + button.stateOffset);
+
+				bAllButtonsHeld = buttonState == PSMButtonState_PRESSED || buttonState == PSMButtonState_DOWN;
+			}
+			else
+			{
+				bAllButtonsHeld = false;
+			}
+		}
+
+		if (!bAllButtonsHeld)
+		{
+			gesture.bIsHeld = false;
+			gesture.bHasFired = false;
+			continue;
+		}
+
+		if (!gesture.bIsHeld)
+		{
+			gesture.bIsHeld = true;
+			gesture.heldSinceSeconds = timeSeconds;
+		}
+
+		if (!gesture.bHasFired && timeSeconds - gesture.heldSinceSeconds >= gesture.holdSeconds)
+		{
+			gesture.bHasFired = true;
+			firedAction = std::max(firedAction, gesture.action);
+		}
+	}
+
+	if (firedAction != k_EGestureAction_None)
+	{
+		// The buttons that completed a gesture are used up: any other gesture 
+		// currently held (e.g. a long press on one of the chord's buttons) waits for a release
+		for (int gestureIndex = 0; gestureIndex < m_gestureCount; ++gestureIndex)
+		{
+			if (m_gestures[gestureIndex].bIsHeld)
+			{
+				m_gestures[gestureIndex].bHasFired = true;
+			}
+		}
+
+		++m_nFiredCount[firedAction];
+	}
+
+	return firedAction;
 }
 
 //==================================================================================================
@@ -1375,24 +3453,23 @@ CPSMoveControllerLatest::CPSMoveControllerLatest(
     , m_nPSMControllerId(psmControllerId)
 	, m_PSMControllerType(psmControllerType)
     , m_PSMControllerView(nullptr)
+	, m_bIsListedByService(true)
+	, m_bIsReconnecting(false)
+	, m_bIsDataStreamStarted(false)
     , m_nPSMChildControllerId(-1)
 	, m_PSMChildControllerType(PSMControllerType::PSMController_None)
     , m_PSMChildControllerView(nullptr)
     , m_nPoseSequenceNumber(0)
+	, m_nPublishedPoseSequenceNumber(0)
+	, m_lastNewSampleTime()
     , m_bIsBatteryCharging(false)
     , m_fBatteryChargeFraction(1.f)
 	, m_bRumbleSuppressed(false)
     , m_pendingHapticPulseDuration(0)
     , m_lastTimeRumbleSent()
     , m_lastTimeRumbleSentValid(false)
-	, m_resetPoseButtonPressTime()
-	, m_bResetPoseRequestSent(false)
-	, m_resetAlignButtonPressTime()
-	, m_bResetAlignRequestSent(false)
 	, m_bUsePSNaviDPadRecenter(false)
 	, m_bUsePSNaviDPadRealign(false)
-	, m_fVirtuallExtendControllersZMeters(0.0f)
-	, m_fVirtuallExtendControllersYMeters(0.0f)
 	, m_bDelayAfterTouchpadPress(false)
 	, m_bTouchpadWasActive(false)
 	, m_bUseSpatialOffsetAfterTouchpadPressAsTouchpadAxis(false)
@@ -1402,11 +3479,16 @@ CPSMoveControllerLatest::CPSMoveControllerLatest(
 	, m_driverSpaceRotationAtTouchpadPressTime(*k_psm_quaternion_identity)
 	, m_bUseControllerOrientationInHMDAlignment(false)
 	, m_triggerAxisIndex(1)
-	, m_thumbstickDeadzone(k_defaultThumbstickDeadZoneRadius)
 	, m_bThumbstickTouchAsPress(true)
+	, m_fPosePredictionSeconds(0.f)
+	, m_lastFrozenPosePublishTime()
+	, m_fStationaryHeartbeatMilliseconds(k_defaultStationaryHeartbeatMilliseconds)
+	, m_nStationarySkippedPoseCount(0)
+	, m_nButtonChangeFrameCount(0)
+	, m_nButtonEventCount(0)
 {
     char svrIdentifier[256];
-    GenerateControllerSteamVRIdentifier(svrIdentifier, sizeof(svrIdentifier), psmControllerId);
+    GenerateControllerSteamVRIdentifier(svrIdentifier, sizeof(svrIdentifier), psmControllerId, psmSerialNo);
     m_strSteamVRSerialNo = svrIdentifier;
 
 	m_lastTouchpadPressTime = std::chrono::high_resolution_clock::now();
@@ -1422,6 +3504,14 @@ CPSMoveControllerLatest::CPSMoveControllerLatest(
     memset(&m_ControllerState, 0, sizeof(vr::VRControllerState_t));
 	m_trackingStatus = vr::TrackingResult_Uninitialized;
 
+	m_qLocalOffsetRotation.w = 1.0;
+	m_qLocalOffsetRotation.x = 0.0;
+	m_qLocalOffsetRotation.y = 0.0;
+	m_qLocalOffsetRotation.z = 0.0;
+	m_vecLocalOffsetTranslation[0] = 0.0;
+	m_vecLocalOffsetTranslation[1] = 0.0;
+	m_vecLocalOffsetTranslation[2] = 0.0;
+
     // Load config from steamvr.vrsettings
     vr::IVRSettings *pSettings= vr::VRSettings();
 
@@ -1498,14 +3588,27 @@ CPSMoveControllerLatest::CPSMoveControllerLatest(
 
 			// General Settings
 			m_bRumbleSuppressed= LoadBool(pSettings, "psmove_settings", "rumble_suppressed", m_bRumbleSuppressed);
-			m_fVirtuallExtendControllersYMeters = LoadFloat(pSettings, "psmove_settings", "psmove_extend_y", 0.0f);
-			m_fVirtuallExtendControllersZMeters = LoadFloat(pSettings, "psmove_settings", "psmove_extend_z", 0.0f);
+
+			// The old virtual extension settings (meters down/forward) become the default local offset
+			{
+				const PSMVector3f defaultOffset = {
+					0.f,
+					-LoadFloat(pSettings, "psmove_settings", "psmove_extend_y", 0.0f),
+					-LoadFloat(pSettings, "psmove_settings", "psmove_extend_z", 0.0f)};
+
+				LoadLocalOffsetSettings(pSettings, defaultOffset);
+			}
 			m_fControllerMetersInFrontOfHmdAtCalibration= 
 				LoadFloat(pSettings, "psmove", "m_fControllerMetersInFrontOfHmdAtCallibration", 0.06f);
 			m_bUseControllerOrientationInHMDAlignment= LoadBool(pSettings, "psmove_settings", "use_orientation_in_alignment", true);
-
-			m_thumbstickDeadzone = 
-				fminf(fmaxf(LoadFloat(pSettings, "psnavi_settings", "thumbstick_deadzone_radius", k_defaultThumbstickDeadZoneRadius), 0.f), 0.99f);
+			m_fPosePredictionSeconds=
+				fminf(fmaxf(LoadFloat(pSettings, "psmove_settings", "prediction_time_ms", 0.f), 0.f), k_maxPosePredictionMilliseconds) / 1000.f;
+			LoadJitterFilterSettings(pSettings, "psmove_settings");
+			LoadStationaryDetectionSettings(pSettings, "psmove_settings");
+			LoadAxisEventFilterSettings(pSettings, "psmove_settings", k_defaultPSMoveAxisQuantizationSteps, k_defaultPSMoveAxisDeadband);
+
+			// The thumbstick is on the attached PSNavi, the trigger is shared by both
+			LoadAnalogStageSettings(pSettings, "psnavi_settings", "psmove_settings");
 			m_bThumbstickTouchAsPress= LoadBool(pSettings, "psnavi_settings", "thumbstick_touch_as_press", true);
 
 			#if LOG_TOUCHPAD_EMULATION != 0
@@ -1542,12 +3645,24 @@ CPSMoveControllerLatest::CPSMoveControllerLatest(
 			m_bRumbleSuppressed= LoadBool(pSettings, "dualshock4_settings", "rumble_suppressed", m_bRumbleSuppressed);
 			m_fControllerMetersInFrontOfHmdAtCalibration= 
 				LoadFloat(pSettings, "dualshock4_settings", "cm_in_front_of_hmd_at_calibration", 16.f) / 100.f;
+			m_fPosePredictionSeconds=
+				fminf(fmaxf(LoadFloat(pSettings, "dualshock4_settings", "prediction_time_ms", 0.f), 0.f), k_maxPosePredictionMilliseconds) / 1000.f;
+			m_velocityEstimator.SetWindowSize(
+				LoadInt(pSettings, "dualshock4_settings", "velocity_estimation_window", k_defaultDS4VelocityEstimationWindow));
+			LoadJitterFilterSettings(pSettings, "dualshock4_settings");
+			LoadStationaryDetectionSettings(pSettings, "dualshock4_settings");
+			LoadAxisEventFilterSettings(pSettings, "dualshock4_settings", k_defaultDS4AxisQuantizationSteps, k_defaultDS4AxisDeadband);
+			LoadAnalogStageSettings(pSettings, "dualshock4_settings", "dualshock4_settings");
+			LoadLocalOffsetSettings(pSettings, *k_psm_float_vector3_zero);
 
 			#if LOG_REALIGN_TO_HMD != 0
 			DriverLog("m_fControllerMetersInFrontOfHmdAtCalibration(ds4): %f\n", m_fControllerMetersInFrontOfHmdAtCalibration);
 			#endif
 		}
 	}
+
+	LoadGestureSettings(pSettings);
+	CompileInputMappings();
 }
 
 CPSMoveControllerLatest::~CPSMoveControllerLatest()
@@ -1691,6 +3806,308 @@ void CPSMoveControllerLatest::LoadButtonMapping(
 	psButtonIDToVrTouchpadDirection[controllerType][psButtonID] = vrTouchpadDirection;
 }
 
+struct InputMappingSource
+{
+	CPSMoveControllerLatest::ePSButtonID buttonId;
+	size_t stateOffset;
+	const char *name; // as used by gesture bindings
+};
+
+// Button sources per controller type, in the order the mappings are applied 
+// (later touchpad directions overwrite earlier ones)
+static const InputMappingSource k_psmoveInputSources[] = {
+	{CPSMoveControllerLatest::k_EPSButtonID_Circle, offsetof(PSMPSMove, CircleButton), "circle"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Cross, offsetof(PSMPSMove, CrossButton), "cross"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Move, offsetof(PSMPSMove, MoveButton), "move"},
+	{CPSMoveControllerLatest::k_EPSButtonID_PS, offsetof(PSMPSMove, PSButton), "ps"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Select, offsetof(PSMPSMove, SelectButton), "select"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Square, offsetof(PSMPSMove, SquareButton), "square"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Start, offsetof(PSMPSMove, StartButton), "start"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Triangle, offsetof(PSMPSMove, TriangleButton), "triangle"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Trigger, offsetof(PSMPSMove, TriggerButton), "trigger"},
+};
+
+static const InputMappingSource k_psnaviInputSources[] = {
+	{CPSMoveControllerLatest::k_EPSButtonID_Circle, offsetof(PSMPSNavi, CircleButton), "circle"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Cross, offsetof(PSMPSNavi, CrossButton), "cross"},
+	{CPSMoveControllerLatest::k_EPSButtonID_PS, offsetof(PSMPSNavi, PSButton), "ps"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Up, offsetof(PSMPSNavi, DPadUpButton), "up"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Down, offsetof(PSMPSNavi, DPadDownButton), "down"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Left, offsetof(PSMPSNavi, DPadLeftButton), "left"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Right, offsetof(PSMPSNavi, DPadRightButton), "right"},
+	{CPSMoveControllerLatest::k_EPSButtonID_L1, offsetof(PSMPSNavi, L1Button), "l1"},
+	{CPSMoveControllerLatest::k_EPSButtonID_L2, offsetof(PSMPSNavi, L2Button), "l2"},
+	{CPSMoveControllerLatest::k_EPSButtonID_L3, offsetof(PSMPSNavi, L3Button), "l3"},
+};
+
+static const InputMappingSource k_ds4InputSources[] = {
+	{CPSMoveControllerLatest::k_EPSButtonID_L1, offsetof(PSMDualShock4, L1Button), "l1"},
+	{CPSMoveControllerLatest::k_EPSButtonID_L2, offsetof(PSMDualShock4, L2Button), "l2"},
+	{CPSMoveControllerLatest::k_EPSButtonID_L3, offsetof(PSMDualShock4, L3Button), "l3"},
+	{CPSMoveControllerLatest::k_EPSButtonID_R1, offsetof(PSMDualShock4, R1Button), "r1"},
+	{CPSMoveControllerLatest::k_EPSButtonID_R2, offsetof(PSMDualShock4, R2Button), "r2"},
+	{CPSMoveControllerLatest::k_EPSButtonID_R3, offsetof(PSMDualShock4, R3Button), "r3"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Circle, offsetof(PSMDualShock4, CircleButton), "circle"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Cross, offsetof(PSMDualShock4, CrossButton), "cross"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Square, offsetof(PSMDualShock4, SquareButton), "square"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Triangle, offsetof(PSMDualShock4, TriangleButton), "triangle"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Up, offsetof(PSMDualShock4, DPadUpButton), "up"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Down, offsetof(PSMDualShock4, DPadDownButton), "down"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Left, offsetof(PSMDualShock4, DPadLeftButton), "left"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Right, offsetof(PSMDualShock4, DPadRightButton), "right"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Options, offsetof(PSMDualShock4, OptionsButton), "options"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Share, offsetof(PSMDualShock4, ShareButton), "share"},
+	{CPSMoveControllerLatest::k_EPSButtonID_Trackpad, offsetof(PSMDualShock4, TrackPadButton), "trackpad"},
+	{CPSMoveControllerLatest::k_EPSButtonID_PS, offsetof(PSMDualShock4, PSButton), "ps"},
+};
+
+void CPSMoveControllerLatest::CompileInputMappings()
+{
+	m_inputMappingCount = 0;
+
+	switch (m_PSMControllerType)
+	{
+	case PSMController_Move:
+		{
+			for (const InputMappingSource &source : k_psmoveInputSources)
+			{
+				AddInputMapping(k_EPSControllerType_Move, source.buttonId, false, source.stateOffset);
+			}
+
+			// Only applied while a PSNavi is attached as the child controller
+			for (const InputMappingSource &source : k_psnaviInputSources)
+			{
+				AddInputMapping(k_EPSControllerType_Navi, source.buttonId, true, source.stateOffset);
+			}
+		} break;
+	case PSMController_DualShock4:
+		{
+			for (const InputMappingSource &source : k_ds4InputSources)
+			{
+				AddInputMapping(k_EPSControllerType_DS4, source.buttonId, false, source.stateOffset);
+			}
+		} break;
+	default:
+		break;
+	}
+}
+
+static bool FindInputSource(
+	const InputMappingSource *sources,
+	size_t sourceCount,
+	const char *name,
+	size_t &outStateOffset)
+{
+	for (size_t sourceIndex = 0; sourceIndex < sourceCount; ++sourceIndex)
+	{
+		if (strcasecmp(sources[sourceIndex].name, name) == 0)
+		{
+			outStateOffset = sources[sourceIndex].stateOffset;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void CPSMoveControllerLatest::LoadGestureSettings(
+	vr::IVRSettings *pSettings)
+{
+	m_gestureEngine.Clear();
+
+	switch (m_PSMControllerType)
+	{
+	case PSMController_Move:
+		{
+			// With a PSNavi attached the recenter hold is longer and moves to the D-pad (unless the D-pad is remapped)
+			LoadGestureBinding(pSettings, "psmove_settings", "realign_gesture", "start+select", 
+				CPSMoveGestureEngine::k_EGestureAction_RealignHMD, CPSMoveGestureEngine::k_EGestureRequirement_Always);
+			LoadGestureBinding(pSettings, "psmove_settings", "recenter_gesture", "select@250", 
+				CPSMoveGestureEngine::k_EGestureAction_RecenterController, CPSMoveGestureEngine::k_EGestureRequirement_NoChildController);
+			LoadGestureBinding(pSettings, "psnavi_settings", "realign_gesture", m_bUsePSNaviDPadRealign ? "navi_up@1000" : "", 
+				CPSMoveGestureEngine::k_EGestureAction_RealignHMD, CPSMoveGestureEngine::k_EGestureRequirement_ChildController);
+			LoadGestureBinding(pSettings, "psnavi_settings", "recenter_gesture", m_bUsePSNaviDPadRecenter ? "navi_down@1000" : "select@1000", 
+				CPSMoveGestureEngine::k_EGestureAction_RecenterController, CPSMoveGestureEngine::k_EGestureRequirement_ChildController);
+		} break;
+	case PSMController_DualShock4:
+		{
+			LoadGestureBinding(pSettings, "dualshock4_settings", "realign_gesture", "share+options", 
+				CPSMoveGestureEngine::k_EGestureAction_RealignHMD, CPSMoveGestureEngine::k_EGestureRequirement_Always);
+			LoadGestureBinding(pSettings, "dualshock4_settings", "recenter_gesture", "options@250", 
+				CPSMoveGestureEngine::k_EGestureAction_RecenterController, CPSMoveGestureEngine::k_EGestureRequirement_Always);
+		} break;
+	default:
+		break;
+	}
+}
+
+void CPSMoveControllerLatest::LoadGestureBinding(
+	vr::IVRSettings *pSettings,
+	const char *pchSection,
+	const char *pchSettingsKey,
+	const char *pchDefaultBinding,
+	CPSMoveGestureEngine::eGestureAction action,
+	CPSMoveGestureEngine::eGestureRequirement requirement)
+{
+	// Bindings look like "<button>[+<button>...][@<hold ms>]", e.g. "start+select" or "navi_down@1000".
+	// Buttons prefixed with "navi_" are read from an attached PSNavi. An empty binding disables the gesture.
+	char szBinding[64];
+	vr::EVRSettingsError fetchError = vr::VRSettingsError_UnsetSettingHasNoDefault;
+
+	if (pSettings != nullptr)
+	{
+		pSettings->GetString(pchSection, pchSettingsKey, szBinding, sizeof(szBinding), &fetchError);
+	}
+
+	if (fetchError != vr::VRSettingsError_None)
+	{
+		strncpy(szBinding, pchDefaultBinding, sizeof(szBinding) - 1);
+		szBinding[sizeof(szBinding) - 1] = '\0';
+	}
+
+	std::string buttonList(szBinding);
+	std::transform(buttonList.begin(), buttonList.end(), buttonList.begin(), ::tolower);
+	float holdMilliseconds = 0.f;
+
+	const size_t holdSeparator = buttonList.find('@');
+	if (holdSeparator != std::string::npos)
+	{
+		holdMilliseconds = static_cast<float>(atof(buttonList.c_str() + holdSeparator + 1));
+		buttonList.resize(holdSeparator);
+	}
+
+	if (buttonList.empty())
+		return;
+
+	const InputMappingSource *sources = nullptr;
+	size_t sourceCount = 0;
+	if (m_PSMControllerType == PSMController_Move)
+	{
+		sources = k_psmoveInputSources;
+		sourceCount = sizeof(k_psmoveInputSources) / sizeof(k_psmoveInputSources[0]);
+	}
+	else if (m_PSMControllerType == PSMController_DualShock4)
+	{
+		sources = k_ds4InputSources;
+		sourceCount = sizeof(k_ds4InputSources) / sizeof(k_ds4InputSources[0]);
+	}
+
+	CPSMoveGestureEngine::GestureButton buttons[CPSMoveGestureEngine::k_maxGestureButtons];
+	int buttonCount = 0;
+
+	std::istringstream buttonStream(buttonList);
+	std::string buttonName;
+	while (std::getline(buttonStream, buttonName, '+'))
+	{
+		const size_t prefixLength = strlen(k_naviGestureButtonPrefix);
+		const bool bIsNaviButton = 
+			m_PSMControllerType == PSMController_Move && 
+			buttonName.compare(0, prefixLength, k_naviGestureButtonPrefix) == 0;
+		size_t stateOffset = 0;
+
+		const bool bFound = 
+			bIsNaviButton
+			? FindInputSource(k_psnaviInputSources, sizeof(k_psnaviInputSources) / sizeof(k_psnaviInputSources[0]), buttonName.c_str() + prefixLength, stateOffset)
+			: FindInputSource(sources, sourceCount, buttonName.c_str(), stateOffset);
+
+		if (!bFound || buttonCount >= CPSMoveGestureEngine::k_maxGestureButtons)
+		{
+			DriverLog("CPSMoveControllerLatest::LoadGestureBinding - Ignoring %s.%s = \"%s\" (bad button \"%s\")\n",
+				pchSection, pchSettingsKey, szBinding, buttonName.c_str());
+			return;
+		}
+
+		buttons[buttonCount].stateOffset = static_cast<uint16_t>(stateOffset);
+		buttons[buttonCount].bIsChildButton = bIsNaviButton;
+		++buttonCount;
+	}
+
+	m_gestureEngine.AddGesture(action, requirement, buttons, buttonCount, holdMilliseconds / 1000.f);
+}
+
+void CPSMoveControllerLatest::AddInputMapping(
+	ePSControllerType controllerType,
+	ePSButtonID buttonId,
+	bool bIsChildButton,
+	size_t stateOffset)
+{
+	static const uint64_t s_kTouchpadButtonMask = vr::ButtonMaskFromId(vr::k_EButton_SteamVR_Touchpad);
+
+	assert(m_inputMappingCount < k_maxInputMappings);
+	InputMappingEntry &entry = m_inputMappings[m_inputMappingCount++];
+
+	const int vrButtonId = psButtonIDToVRButtonID[controllerType][buttonId];
+
+	entry.stateOffset = static_cast<uint16_t>(stateOffset);
+	entry.bIsChildButton = bIsChildButton;
+	entry.stateMask = PSMButtonState_PRESSED | PSMButtonState_DOWN;
+	entry.touchpadAxisMask = 0;
+	entry.pressedMask = (vrButtonId >= 0 && vrButtonId < 64) ? vr::ButtonMaskFromId(static_cast<vr::EVRButtonId>(vrButtonId)) : 0;
+	entry.touchedMask = 0;
+	entry.touchpadX = 0.f;
+	entry.touchpadY = 0.f;
+
+	// The DS4 has real axes, so its buttons never emulate the touchpad
+	if (controllerType == k_EPSControllerType_DS4)
+	{
+		return;
+	}
+
+	if (vrButtonId == k_touchpadTouchMapping)
+	{
+		entry.pressedMask = 0;
+		entry.touchedMask = s_kTouchpadButtonMask;
+		return;
+	}
+
+	switch (psButtonIDToVrTouchpadDirection[controllerType][buttonId])
+	{
+	case k_EVRTouchpadDirection_Left:
+		entry.touchpadAxisMask = k_EInputMappingAxis_X;
+		entry.touchpadX = -1.0f;
+		break;
+	case k_EVRTouchpadDirection_Right:
+		entry.touchpadAxisMask = k_EInputMappingAxis_X;
+		entry.touchpadX = 1.0f;
+		break;
+	case k_EVRTouchpadDirection_Up:
+		entry.touchpadAxisMask = k_EInputMappingAxis_Y;
+		entry.touchpadY = 1.0f;
+		break;
+	case k_EVRTouchpadDirection_Down:
+		entry.touchpadAxisMask = k_EInputMappingAxis_Y;
+		entry.touchpadY = -1.0f;
+		break;
+	case k_EVRTouchpadDirection_UpLeft:
+		entry.touchpadAxisMask = k_EInputMappingAxis_X | k_EInputMappingAxis_Y;
+		entry.touchpadX = -0.707f;
+		entry.touchpadY = 0.707f;
+		break;
+	case k_EVRTouchpadDirection_UpRight:
+		entry.touchpadAxisMask = k_EInputMappingAxis_X | k_EInputMappingAxis_Y;
+		entry.touchpadX = 0.707f;
+		entry.touchpadY = 0.707f;
+		break;
+	case k_EVRTouchpadDirection_DownLeft:
+		entry.touchpadAxisMask = k_EInputMappingAxis_X | k_EInputMappingAxis_Y;
+		entry.touchpadX = -0.707f;
+		entry.touchpadY = -0.707f;
+		break;
+	case k_EVRTouchpadDirection_DownRight:
+		entry.touchpadAxisMask = k_EInputMappingAxis_X | k_EInputMappingAxis_Y;
+		entry.touchpadX = 0.707f;
+		entry.touchpadY = -0.707f;
+		break;
+	default:
+		break;
+	}
+
+	if (entry.touchpadAxisMask != 0)
+	{
+		entry.pressedMask |= s_kTouchpadButtonMask;
+	}
+}
+
 bool CPSMoveControllerLatest::LoadBool(
     vr::IVRSettings *pSettings,
 	const char *pchSection,
@@ -1742,8 +4159,93 @@ float CPSMoveControllerLatest::LoadFloat(
 	return fResult;
 }
 
+void CPSMoveControllerLatest::LoadJitterFilterSettings(
+    vr::IVRSettings *pSettings,
+	const char *pchSection)
+{
+	m_poseJitterFilter.SetParameters(
+		LoadFloat(pSettings, pchSection, "filter_min_cutoff_hz", k_defaultJitterFilterMinCutoffHz),
+		LoadFloat(pSettings, pchSection, "filter_position_beta", k_defaultJitterFilterPositionBeta),
+		LoadFloat(pSettings, pchSection, "filter_rotation_beta", k_defaultJitterFilterRotationBeta),
+		LoadFloat(pSettings, pchSection, "filter_derivative_cutoff_hz", k_defaultJitterFilterDerivativeCutoffHz));
+	m_poseJitterFilter.SetEnabled(LoadBool(pSettings, pchSection, "jitter_filter_enabled", false));
+}
+
+void CPSMoveControllerLatest::LoadStationaryDetectionSettings(
+    vr::IVRSettings *pSettings,
+	const char *pchSection)
+{
+	m_stationaryDetector.SetParameters(
+		LoadFloat(pSettings, pchSection, "stationary_linear_speed_threshold", k_defaultStationaryLinearSpeedThreshold),
+		LoadFloat(pSettings, pchSection, "stationary_angular_speed_threshold", k_defaultStationaryAngularSpeedThreshold),
+		LoadFloat(pSettings, pchSection, "stationary_position_tolerance_mm", k_defaultStationaryPositionToleranceMillimeters) / 1000.f,
+		LoadFloat(pSettings, pchSection, "stationary_angle_tolerance_degrees", k_defaultStationaryAngleToleranceDegrees) / k_fRadiansToDegrees,
+		LoadFloat(pSettings, pchSection, "stationary_settle_time_ms", k_defaultStationarySettleTimeMilliseconds) / 1000.f);
+	m_stationaryDetector.SetEnabled(LoadBool(pSettings, pchSection, "stationary_detection_enabled", false));
+	m_fStationaryHeartbeatMilliseconds = 
+		fmaxf(LoadFloat(pSettings, pchSection, "stationary_heartbeat_ms", k_defaultStationaryHeartbeatMilliseconds), 0.f);
+}
+
+void CPSMoveControllerLatest::LoadAnalogStageSettings(
+    vr::IVRSettings *pSettings,
+	const char *pchStickSection,
+	const char *pchTriggerSection)
+{
+	m_analogStage.SetStickParameters(
+		LoadFloat(pSettings, pchStickSection, "thumbstick_deadzone_radius", k_defaultThumbstickDeadZoneRadius),
+		LoadFloat(pSettings, pchStickSection, "thumbstick_response_curve", 1.f));
+	m_analogStage.SetTriggerParameters(
+		LoadFloat(pSettings, pchTriggerSection, "trigger_deadzone", 0.f),
+		LoadFloat(pSettings, pchTriggerSection, "trigger_response_curve", 1.f),
+		LoadFloat(pSettings, pchTriggerSection, "trigger_touch_threshold", k_defaultTriggerTouchThreshold),
+		LoadFloat(pSettings, pchTriggerSection, "trigger_press_threshold", k_defaultTriggerPressThreshold),
+		LoadFloat(pSettings, pchTriggerSection, "trigger_hysteresis", k_defaultTriggerHysteresis));
+}
+
+void CPSMoveControllerLatest::LoadAxisEventFilterSettings(
+    vr::IVRSettings *pSettings,
+	const char *pchSection,
+	int defaultQuantizationSteps,
+	float defaultDeadband)
+{
+	m_axisEventFilter.SetParameters(
+		LoadInt(pSettings, pchSection, "axis_quantization_steps", defaultQuantizationSteps),
+		LoadFloat(pSettings, pchSection, "axis_deadband", defaultDeadband),
+		LoadFloat(pSettings, pchSection, "axis_max_event_rate_hz", 0.f));
+}
+
+void CPSMoveControllerLatest::LoadLocalOffsetSettings(
+    vr::IVRSettings *pSettings,
+	const PSMVector3f &defaultTranslationMeters)
+{
+	// Offsets are per physical controller, e.g. [controller_offset_00:06:f7:c9:a1:fb]
+	const std::string section = "controller_offset_" + m_strPSMControllerSerialNo;
+	const char *pchSection = section.c_str();
+
+	// Translation in meters in the controller's frame (+X right, +Y up, -Z forward)
+	m_vecLocalOffsetTranslation[0] = LoadFloat(pSettings, pchSection, "translation_x", defaultTranslationMeters.x);
+	m_vecLocalOffsetTranslation[1] = LoadFloat(pSettings, pchSection, "translation_y", defaultTranslationMeters.y);
+	m_vecLocalOffsetTranslation[2] = LoadFloat(pSettings, pchSection, "translation_z", defaultTranslationMeters.z);
+
+	// Rotation applied as yaw (about +Y), then pitch (about +X), then roll (about -Z)
+	const double halfYaw = LoadFloat(pSettings, pchSection, "yaw_degrees", 0.f) / k_fRadiansToDegrees * 0.5;
+	const double halfPitch = LoadFloat(pSettings, pchSection, "pitch_degrees", 0.f) / k_fRadiansToDegrees * 0.5;
+	const double halfRoll = LoadFloat(pSettings, pchSection, "roll_degrees", 0.f) / k_fRadiansToDegrees * 0.5;
+	const vr::HmdQuaternion_t yaw = { cos(halfYaw), 0.0, sin(halfYaw), 0.0 };
+	const vr::HmdQuaternion_t pitch = { cos(halfPitch), sin(halfPitch), 0.0, 0.0 };
+	const vr::HmdQuaternion_t roll = { cos(halfRoll), 0.0, 0.0, -sin(halfRoll) };
+
+	m_qLocalOffsetRotation = hmdQuaternionMultiply(hmdQuaternionMultiply(yaw, pitch), roll);
+
+	DriverLog("CPSMoveControllerLatest::LoadLocalOffsetSettings - %s offset: (%.3f, %.3f, %.3f)m, rotation: (%.3f, %.3f, %.3f, %.3f)\n",
+		m_strPSMControllerSerialNo.c_str(),
+		m_vecLocalOffsetTranslation[0], m_vecLocalOffsetTranslation[1], m_vecLocalOffsetTranslation[2],
+		m_qLocalOffsetRotation.w, m_qLocalOffsetRotation.x, m_qLocalOffsetRotation.y, m_qLocalOffsetRotation.z);
+}
+
 vr::EVRInitError CPSMoveControllerLatest::Activate(vr::TrackedDeviceIndex_t unObjectId)
 {
+	std::lock_guard<std::recursive_mutex> guard(g_ServerTrackedDeviceProvider.GetPSMClientMutex());
     vr::EVRInitError result = CPSMoveTrackedDeviceLatest::Activate(unObjectId);
 
     if (result == vr::VRInitError_None)    
@@ -1752,14 +4254,8 @@ vr::EVRInitError CPSMoveControllerLatest::Activate(vr::TrackedDeviceIndex_t unOb
 
 		g_ServerTrackedDeviceProvider.LaunchPSMoveMonitor();
 
-		PSMRequestID requestId;
-		if (PSM_StartControllerDataStreamAsync(
-				m_PSMControllerView->ControllerID, 
-				PSMStreamFlags_includePositionData | PSMStreamFlags_includePhysicsData, 
-				&requestId) == PSMResult_Success)
-		{
-			PSM_RegisterCallback(requestId, CPSMoveControllerLatest::start_controller_response_callback, this);
-		}
+		// Normally already started when the controller was allocated
+		StartControllerDataStream();
 
 		// Setup controller properties
 		{
@@ -1820,6 +4316,99 @@ vr::EVRInitError CPSMoveControllerLatest::Activate(vr::TrackedDeviceIndex_t unOb
     return result;
 }
 
+void CPSMoveControllerLatest::StartControllerDataStream()
+{
+	if (m_bIsDataStreamStarted || !m_bIsListedByService)
+		return;
+
+	PSMRequestID requestId;
+	if (PSM_StartControllerDataStreamAsync(
+			m_PSMControllerView->ControllerID, 
+			PSMStreamFlags_includePositionData | PSMStreamFlags_includePhysicsData, 
+			&requestId) == PSMResult_Success)
+	{
+		PSM_RegisterCallback(requestId, CPSMoveControllerLatest::start_controller_response_callback, this);
+		m_bIsDataStreamStarted = true;
+	}
+}
+
+void CPSMoveControllerLatest::StopControllerDataStream()
+{
+	if (!m_bIsDataStreamStarted)
+		return;
+
+	PSM_StopControllerDataStreamAsync(m_nPSMControllerId, nullptr);
+	m_bIsDataStreamStarted = false;
+}
+
+void CPSMoveControllerLatest::ReleasePSMController()
+{
+	if (!m_bIsListedByService)
+		return;
+
+	StopControllerDataStream();
+
+	PSM_FreeControllerListener(m_nPSMControllerId);
+	m_bIsListedByService = false;
+}
+
+void CPSMoveControllerLatest::AcquirePSMController(int psmControllerId)
+{
+	if (m_bIsListedByService)
+		return;
+
+	m_nPSMControllerId = psmControllerId;
+	PSM_AllocateControllerListener(psmControllerId);
+	m_PSMControllerView = PSM_GetController(psmControllerId);
+	m_bIsListedByService = true;
+	m_bIsReconnecting = false;
+
+	// Sequence numbers and pose history belong to the old stream
+	m_nPoseSequenceNumber = 0;
+	m_nPublishedPoseSequenceNumber = 0;
+	m_poseHistory.Clear();
+	m_poseJitterFilter.Reset();
+	m_stationaryDetector.Reset();
+
+	StartControllerDataStream();
+}
+
+void CPSMoveControllerLatest::EnterReconnectingState()
+{
+	// The connection (and with it all of the listeners and streams) is already gone,
+	// so there's nothing to release on the client API side
+	m_bIsListedByService = false;
+	m_bIsReconnecting = true;
+	m_bIsDataStreamStarted = false;
+
+	// The navi gets re-attached from the next controller list
+	m_nPSMChildControllerId = -1;
+	m_PSMChildControllerType = PSMControllerType::PSMController_None;
+	m_PSMChildControllerView = nullptr;
+
+	if (!IsActivated())
+		return;
+
+	// Keep the last pose, but let vrserver know it's not being tracked right now
+	m_Pose.result = vr::TrackingResult_Running_OutOfRange;
+
+	vr::VRServerDriverHost()->TrackedDevicePoseUpdated(m_unSteamVRTrackedDeviceId, m_Pose, sizeof(vr::DriverPose_t));
+}
+
+void CPSMoveControllerLatest::PublishDisconnectedPose()
+{
+	m_bIsReconnecting = false;
+
+	if (!IsActivated())
+		return;
+
+	m_Pose.result = vr::TrackingResult_Uninitialized;
+	m_Pose.deviceIsConnected = false;
+	m_Pose.poseIsValid = false;
+
+	vr::VRServerDriverHost()->TrackedDevicePoseUpdated(m_unSteamVRTrackedDeviceId, m_Pose, sizeof(vr::DriverPose_t));
+}
+
 void CPSMoveControllerLatest::start_controller_response_callback(
     const PSMResponseMessage *response, void *userdata)
 {
@@ -1833,8 +4422,9 @@ void CPSMoveControllerLatest::start_controller_response_callback(
 
 void CPSMoveControllerLatest::Deactivate()
 {
+	std::lock_guard<std::recursive_mutex> guard(g_ServerTrackedDeviceProvider.GetPSMClientMutex());
 	DriverLog("CPSMoveControllerLatest::Deactivate - Controller stream stopped\n");
-    PSM_StopControllerDataStreamAsync(m_PSMControllerView->ControllerID, nullptr);
+    StopControllerDataStream();
 }
 
 void *CPSMoveControllerLatest::GetComponent(const char *pchComponentNameAndVersion)
@@ -1847,140 +4437,202 @@ void *CPSMoveControllerLatest::GetComponent(const char *pchComponentNameAndVersi
     return NULL;
 }
 
+void CPSMoveControllerLatest::DebugRequest(
+    const char * pchRequest,
+    char * pchResponseBuffer,
+    uint32_t unResponseBufferSize)
+{
+	std::lock_guard<std::recursive_mutex> guard(g_ServerTrackedDeviceProvider.GetPSMClientMutex());
+	std::istringstream ss( pchRequest );
+	std::string strCmd;
+
+	ss >> strCmd;
+	if (strCmd == "psmove:pose_history")
+	{
+		// Reports how much pose history we have and how stale the newest sample is
+		if (pchResponseBuffer != nullptr && unResponseBufferSize > 0)
+		{
+			const double nowSeconds = 
+				std::chrono::duration<double>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+			const int sampleCount = m_poseHistory.GetSampleCount();
+			CPSMovePoseHistory::Sample oldestSample;
+			double latestAgeSeconds = 0.0;
+			double spanSeconds = 0.0;
+
+			if (m_poseHistory.GetLatestAgeSeconds(nowSeconds, latestAgeSeconds) &&
+				m_poseHistory.GetSample(sampleCount - 1, oldestSample))
+			{
+				spanSeconds = nowSeconds - latestAgeSeconds - oldestSample.timeSeconds;
+			}
+
+			snprintf(pchResponseBuffer, unResponseBufferSize,
+				"samples=%d latest_age_ms=%.2f span_ms=%.2f replaced=%llu dropped=%llu",
+				sampleCount, latestAgeSeconds * 1000.0, spanSeconds * 1000.0,
+				m_poseHistory.GetReplacedSampleCount(), m_poseHistory.GetDroppedSampleCount());
+			pchResponseBuffer[unResponseBufferSize - 1] = '\0';
+		}
+	}
+	else if (strCmd == "psmove:button_stats")
+	{
+		// Reports how many button events this controller has sent to vrserver
+		if (pchResponseBuffer != nullptr && unResponseBufferSize > 0)
+		{
+			snprintf(pchResponseBuffer, unResponseBufferSize,
+				"frames_with_changes=%llu events=%llu",
+				m_nButtonChangeFrameCount,
+				m_nButtonEventCount);
+			pchResponseBuffer[unResponseBufferSize - 1] = '\0';
+		}
+	}
+	else if (strCmd == "psmove:axis_stats")
+	{
+		// Reports how many axis events the axis filter let through and how many it dropped
+		if (pchResponseBuffer != nullptr && unResponseBufferSize > 0)
+		{
+			snprintf(pchResponseBuffer, unResponseBufferSize,
+				"sent=%llu suppressed_deadband=%llu suppressed_rate=%llu",
+				m_axisEventFilter.GetSentEventCount(),
+				m_axisEventFilter.GetDeadbandSuppressedCount(),
+				m_axisEventFilter.GetRateSuppressedCount());
+			pchResponseBuffer[unResponseBufferSize - 1] = '\0';
+		}
+	}
+	else if (strCmd == "psmove:gesture_stats")
+	{
+		// Reports the configured gestures and how often each action was triggered
+		if (pchResponseBuffer != nullptr && unResponseBufferSize > 0)
+		{
+			snprintf(pchResponseBuffer, unResponseBufferSize,
+				"gestures=%d recenter=%llu realign=%llu",
+				m_gestureEngine.GetGestureCount(),
+				m_gestureEngine.GetFiredCount(CPSMoveGestureEngine::k_EGestureAction_RecenterController),
+				m_gestureEngine.GetFiredCount(CPSMoveGestureEngine::k_EGestureAction_RealignHMD));
+			pchResponseBuffer[unResponseBufferSize - 1] = '\0';
+		}
+	}
+	else if (strCmd == "psmove:stationary_stats")
+	{
+		// Reports how often the controller came to rest and how many pose updates that saved
+		if (pchResponseBuffer != nullptr && unResponseBufferSize > 0)
+		{
+			snprintf(pchResponseBuffer, unResponseBufferSize,
+				"enabled=%d stationary=%d times_stationary=%llu pose_updates_skipped=%llu",
+				m_stationaryDetector.IsEnabled() ? 1 : 0,
+				m_stationaryDetector.IsStationary() ? 1 : 0,
+				m_stationaryDetector.GetStationaryEntryCount(),
+				m_nStationarySkippedPoseCount);
+			pchResponseBuffer[unResponseBufferSize - 1] = '\0';
+		}
+	}
+	else if (strCmd == "psmove:filter_stats")
+	{
+		// Reports the latency the jitter filter is adding to this controller
+		if (pchResponseBuffer != nullptr && unResponseBufferSize > 0)
+		{
+			snprintf(pchResponseBuffer, unResponseBufferSize,
+				"enabled=%d samples=%d position_lag_ms=%.2f(avg %.2f) rotation_lag_ms=%.2f(avg %.2f)",
+				m_poseJitterFilter.IsEnabled() ? 1 : 0,
+				m_poseJitterFilter.GetFilteredSampleCount(),
+				m_poseJitterFilter.GetLastPositionLagSeconds() * 1000.0,
+				m_poseJitterFilter.GetAveragePositionLagSeconds() * 1000.0,
+				m_poseJitterFilter.GetLastRotationLagSeconds() * 1000.0,
+				m_poseJitterFilter.GetAverageRotationLagSeconds() * 1000.0);
+			pchResponseBuffer[unResponseBufferSize - 1] = '\0';
+		}
+	}
+	else
+	{
+		CPSMoveTrackedDeviceLatest::DebugRequest(pchRequest, pchResponseBuffer, unResponseBufferSize);
+	}
+}
+
 vr::VRControllerState_t CPSMoveControllerLatest::GetControllerState()
 {
+	std::lock_guard<std::recursive_mutex> guard(g_ServerTrackedDeviceProvider.GetPSMClientMutex());
     return m_ControllerState;
 }
 
 bool CPSMoveControllerLatest::TriggerHapticPulse( uint32_t unAxisId, uint16_t usPulseDurationMicroseconds )
 {
+	std::lock_guard<std::recursive_mutex> guard(g_ServerTrackedDeviceProvider.GetPSMClientMutex());
     m_pendingHapticPulseDuration = usPulseDurationMicroseconds;
     UpdateRumbleState();
 
     return true;
 }
 
+static inline int FindLowestSetBit(uint64_t ulMask)
+{
+	assert(ulMask != 0);
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+	unsigned long index;
+	_BitScanForward64(&index, ulMask);
+	return static_cast<int>(index);
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanForward(&index, static_cast<unsigned long>(ulMask)))
+	{
+		return static_cast<int>(index);
+	}
+	_BitScanForward(&index, static_cast<unsigned long>(ulMask >> 32));
+	return static_cast<int>(index) + 32;
+#else
+	return __builtin_ctzll(ulMask);
+#endif
+}
+
 void CPSMoveControllerLatest::SendButtonUpdates( ButtonUpdate ButtonEvent, uint64_t ulMask )
 {
-    if ( !ulMask )
-        return;
+	if ( !ulMask )
+		return;
 
-    for ( int i = 0; i< vr::k_EButton_Max; i++ )
-    {
-        vr::EVRButtonId button = ( vr::EVRButtonId )i;
+	vr::IVRServerDriverHost *pDriverHost = vr::VRServerDriverHost();
 
-        uint64_t bit = ButtonMaskFromId( button );
+	// Visit only the set bits, lowest button id first
+	while ( ulMask != 0 )
+	{
+		const vr::EVRButtonId button = static_cast<vr::EVRButtonId>( FindLowestSetBit( ulMask ) );
 
-        if ( bit & ulMask )
-        {
-            ( vr::VRServerDriverHost()->*ButtonEvent )( m_unSteamVRTrackedDeviceId, button, 0.0 );
-        }
-    }
+		ulMask &= ulMask - 1;
+
+		( pDriverHost->*ButtonEvent )( m_unSteamVRTrackedDeviceId, button, 0.0 );
+		++m_nButtonEventCount;
+	}
 }
 
 void CPSMoveControllerLatest::UpdateControllerState()
 {
     assert(m_PSMControllerView != nullptr);
-    assert(m_PSMControllerView->IsConnected);
-
-    vr::VRControllerState_t NewState = { 0 };
-
-    // Changing unPacketNum tells anyone polling state that something might have
-    // changed.  We don't try to be precise about that here.
-    NewState.unPacketNum = m_ControllerState.unPacketNum + 1;
-   
-    switch (m_PSMControllerView->ControllerType)
-    {
-    case PSMController_Move:
-        {
-            const PSMPSMove &clientView = m_PSMControllerView->ControllerState.PSMoveState;
-
-			bool bStartRealignHMDTriggered =
-				(clientView.StartButton == PSMButtonState_PRESSED && clientView.SelectButton == PSMButtonState_PRESSED) ||
-				(clientView.StartButton == PSMButtonState_PRESSED && clientView.SelectButton == PSMButtonState_DOWN) ||
-				(clientView.StartButton == PSMButtonState_DOWN && clientView.SelectButton == PSMButtonState_PRESSED);
-
-			// Check if the PSMove has a PSNavi child
-			const bool bHasChildNavi= 
-				m_PSMChildControllerView != nullptr && 
-				m_PSMChildControllerView->ControllerType == PSMController_Navi;
-
-			// See if the recenter button has been held for the requisite amount of time
-			bool bRecenterRequestTriggered = false;
-			{
-				PSMButtonState resetPoseButtonState = clientView.SelectButton;
-				PSMButtonState resetAlignButtonState;
-
-				// Use PSNavi D-pad up/down if they are free
-				if (bHasChildNavi)
-				{
-					if (m_bUsePSNaviDPadRealign)
-					{
-						resetAlignButtonState = m_PSMChildControllerView->ControllerState.PSNaviState.DPadUpButton;
-
-						switch (resetAlignButtonState)
-						{
-						case PSMButtonState_PRESSED:
-							{
-								m_resetAlignButtonPressTime = std::chrono::high_resolution_clock::now();
-							} break;
-						case PSMButtonState_DOWN:
-							{
-								if (!m_bResetAlignRequestSent)
-								{
-									const float k_hold_duration_milli = 1000.f;
-									std::chrono::time_point<std::chrono::high_resolution_clock> now = std::chrono::high_resolution_clock::now();
-									std::chrono::duration<float, std::milli> pressDurationMilli = now - m_resetAlignButtonPressTime;
-
-									if (pressDurationMilli.count() >= k_hold_duration_milli)
-									{
-										bStartRealignHMDTriggered = true;
-									}
-								}
-							} break;
-						case PSMButtonState_RELEASED:
-							{
-								m_bResetAlignRequestSent = false;
-							} break;
-						}
-					}
-					
-					if (m_bUsePSNaviDPadRecenter)
-					{
-						resetPoseButtonState = m_PSMChildControllerView->ControllerState.PSNaviState.DPadDownButton;
-					}
-				}
+    assert(m_PSMControllerView->IsConnected);
 
-				switch (resetPoseButtonState)
-				{
-				case PSMButtonState_PRESSED:
-					{
-						m_resetPoseButtonPressTime = std::chrono::high_resolution_clock::now();
-					} break;
-				case PSMButtonState_DOWN:
-					{
-						if (!m_bResetPoseRequestSent)
-						{
-							const float k_hold_duration_milli = (bHasChildNavi) ? 1000.f : 250.f;
-							std::chrono::time_point<std::chrono::high_resolution_clock> now = std::chrono::high_resolution_clock::now();
-							std::chrono::duration<float, std::milli> pressDurationMilli = now - m_resetPoseButtonPressTime;
+    vr::VRControllerState_t NewState = { 0 };
 
-							if (pressDurationMilli.count() >= k_hold_duration_milli)
-							{
-								bRecenterRequestTriggered = true;
-							}
-						}
-					} break;
-				case PSMButtonState_RELEASED:
-					{
-						m_bResetPoseRequestSent = false;
-					} break;
-				}
-			}
+    // Changing unPacketNum tells anyone polling state that something might have
+    // changed.  We don't try to be precise about that here.
+    NewState.unPacketNum = m_ControllerState.unPacketNum + 1;
+
+	// One timestamp for everything time based in this update
+	const std::chrono::time_point<std::chrono::high_resolution_clock> now = std::chrono::high_resolution_clock::now();
+	const double nowSeconds = std::chrono::duration<double>(now.time_since_epoch()).count();
+   
+    switch (m_PSMControllerView->ControllerType)
+    {
+    case PSMController_Move:
+        {
+            const PSMPSMove &clientView = m_PSMControllerView->ControllerState.PSMoveState;
+
+			// Check if the PSMove has a PSNavi child
+			const bool bHasChildNavi= 
+				m_PSMChildControllerView != nullptr && 
+				m_PSMChildControllerView->ControllerType == PSMController_Navi;
+
+			const CPSMoveGestureEngine::eGestureAction gestureAction = 
+				m_gestureEngine.Update(m_PSMControllerView, bHasChildNavi ? m_PSMChildControllerView : nullptr, nowSeconds);
 
-            // If START was just pressed while and SELECT was held or vice versa,
+            // If START was just pressed while and SELECT was held or vice versa (or another realign gesture completed),
 			// recenter the controller orientation pose and start the realignment of the controller to HMD tracking space.
-            if (bStartRealignHMDTriggered)                
+            if (gestureAction == CPSMoveGestureEngine::k_EGestureAction_RealignHMD)
             {
 				PSMVector3f controllerBallPointedUpEuler = {(float)M_PI_2, 0.0f, 0.0f};
 				PSMQuatf controllerBallPointedUpQuat = PSM_QuatfCreateFromAngles(&controllerBallPointedUpEuler);
@@ -1990,51 +4642,23 @@ void CPSMoveControllerLatest::UpdateControllerState()
 				#endif
 
 				PSM_ResetControllerOrientationAsync(m_PSMControllerView->ControllerID, &controllerBallPointedUpQuat, nullptr);
-				m_bResetPoseRequestSent = true;
 
 				StartRealignHMDTrackingSpace();
-				m_bResetAlignRequestSent = true;
             }
-			else if (bRecenterRequestTriggered)
+			else if (gestureAction == CPSMoveGestureEngine::k_EGestureAction_RecenterController)
 			{
 				DriverLog("CPSMoveControllerLatest::UpdateControllerState(): Calling ClientPSMoveAPI::reset_orientation() in response to controller button press.\n");
 
 				PSM_ResetControllerOrientationAsync(m_PSMControllerView->ControllerID, k_psm_quaternion_identity, nullptr);
-				m_bResetPoseRequestSent = true;
 			}
 			else 
 			{
 				// Process all the button mappings 
 				// ------
 
-				// Handle buttons/virtual touchpad buttons on the psmove
-				m_touchpadDirectionsUsed = false;
-				UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Move, k_EPSButtonID_Circle, clientView.CircleButton, &NewState);
-				UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Move, k_EPSButtonID_Cross, clientView.CrossButton, &NewState);
-				UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Move, k_EPSButtonID_Move, clientView.MoveButton, &NewState);
-				UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Move, k_EPSButtonID_PS, clientView.PSButton, &NewState);
-				UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Move, k_EPSButtonID_Select, clientView.SelectButton, &NewState);
-				UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Move, k_EPSButtonID_Square, clientView.SquareButton, &NewState);
-				UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Move, k_EPSButtonID_Start, clientView.StartButton, &NewState);
-				UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Move, k_EPSButtonID_Triangle, clientView.TriangleButton, &NewState);
-				UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Move, k_EPSButtonID_Trigger, clientView.TriggerButton, &NewState);
-
-				// Handle buttons/virtual touchpad buttons on the psnavi
-				if (bHasChildNavi)
-				{
-					const PSMPSNavi &naviClientView = m_PSMChildControllerView->ControllerState.PSNaviState;
-
-					UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Navi, k_EPSButtonID_Circle, naviClientView.CircleButton, &NewState);
-					UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Navi, k_EPSButtonID_Cross, naviClientView.CrossButton, &NewState);
-					UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Navi, k_EPSButtonID_PS, naviClientView.PSButton, &NewState);
-					UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Navi, k_EPSButtonID_Up, naviClientView.DPadUpButton, &NewState);
-					UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Navi, k_EPSButtonID_Down, naviClientView.DPadDownButton, &NewState);
-					UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Navi, k_EPSButtonID_Left, naviClientView.DPadLeftButton, &NewState);
-					UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Navi, k_EPSButtonID_Right, naviClientView.DPadRightButton, &NewState);
-					UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Navi, k_EPSButtonID_L1, naviClientView.L1Button, &NewState);
-					UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Navi, k_EPSButtonID_L2, naviClientView.L2Button, &NewState);
-					UpdateControllerStateFromPsMoveButtonState(k_EPSControllerType_Navi, k_EPSButtonID_L3, naviClientView.L3Button, &NewState);
-				}
+				// Handle buttons/virtual touchpad buttons on the psmove and psnavi
+				// (the psnavi mappings only apply when one is attached)
+				ApplyInputMappings(bHasChildNavi, &NewState);
 
 				// Touchpad handling
 				if (!m_touchpadDirectionsUsed)
@@ -2045,18 +4669,14 @@ void CPSMoveControllerLatest::UpdateControllerState()
 					if (bHasChildNavi)
 					{
 						const PSMPSNavi &naviClientView = m_PSMChildControllerView->ControllerState.PSNaviState;
-						const float thumbStickX = naviClientView.Stick_XAxis;
-						const float thumbStickY = naviClientView.Stick_YAxis;
-						const float thumbStickRadialDist= sqrtf(thumbStickX*thumbStickX + thumbStickY*thumbStickY);
+						float thumbStickX = naviClientView.Stick_XAxis;
+						float thumbStickY = naviClientView.Stick_YAxis;
 
-						if (thumbStickRadialDist >= m_thumbstickDeadzone)
+						if (m_analogStage.ProcessStick(thumbStickX, thumbStickY))
 						{
-							// Rescale the thumbstick position to hide the dead zone
-							const float rescaledRadius= (thumbStickRadialDist - m_thumbstickDeadzone) / (1.f - m_thumbstickDeadzone);
-
 							// Set the thumbstick axis
-							NewState.rAxis[0].x = (rescaledRadius / thumbStickRadialDist) * thumbStickX;
-							NewState.rAxis[0].y = (rescaledRadius / thumbStickRadialDist) * thumbStickY;
+							NewState.rAxis[0].x = thumbStickX;
+							NewState.rAxis[0].y = thumbStickY;
 
 							// Also make sure the touchpad is considered "touched" 
 							// if the thumbstick is outside of the deadzone
@@ -2080,8 +4700,6 @@ void CPSMoveControllerLatest::UpdateControllerState()
 
 							if (m_bDelayAfterTouchpadPress)
 							{					
-								std::chrono::time_point<std::chrono::high_resolution_clock> now = std::chrono::high_resolution_clock::now();
-
 								if (!m_bTouchpadWasActive)
 								{
 									const float k_max_touchpad_press = 2000.0; // time until coordinates are reset, otherwise assume in last location.
@@ -2141,40 +4759,36 @@ void CPSMoveControllerLatest::UpdateControllerState()
 				}
 
 				// Touchpad SteamVR Events
-				if (NewState.rAxis[0].x != m_ControllerState.rAxis[0].x || 
-					NewState.rAxis[0].y != m_ControllerState.rAxis[0].y)
-				{					
-					vr::VRServerDriverHost()->TrackedDeviceAxisUpdated(m_unSteamVRTrackedDeviceId, 0, NewState.rAxis[0]);
-				}
+				SendAxisUpdate(0, NewState, nowSeconds);
 
 				// PSMove Trigger handling
-				NewState.rAxis[m_triggerAxisIndex].x = clientView.TriggerValue / 255.f;
-				NewState.rAxis[m_triggerAxisIndex].y = 0.f;
+				float triggerValue = clientView.TriggerValue / 255.f;
 
 				// Attached PSNavi Trigger handling
 				if (bHasChildNavi)
 				{
 					const PSMPSNavi &naviClientView = m_PSMChildControllerView->ControllerState.PSNaviState;
 
-					NewState.rAxis[m_triggerAxisIndex].x = fmaxf(NewState.rAxis[m_triggerAxisIndex].x, naviClientView.TriggerValue / 255.f);
+					triggerValue = fmaxf(triggerValue, naviClientView.TriggerValue / 255.f);
 				}
 
-				// Trigger SteamVR Events
-				if (NewState.rAxis[m_triggerAxisIndex].x != m_ControllerState.rAxis[m_triggerAxisIndex].x)
-				{
-					if (NewState.rAxis[m_triggerAxisIndex].x > 0.1f)
-					{
-						NewState.ulButtonTouched |= vr::ButtonMaskFromId(static_cast<vr::EVRButtonId>(vr::k_EButton_Axis0 + m_triggerAxisIndex));
-					}
+				NewState.rAxis[m_triggerAxisIndex].x = m_analogStage.ProcessTrigger(0, triggerValue);
+				NewState.rAxis[m_triggerAxisIndex].y = 0.f;
 
-					if (NewState.rAxis[m_triggerAxisIndex].x > 0.8f)
-					{
-						NewState.ulButtonPressed |= vr::ButtonMaskFromId(static_cast<vr::EVRButtonId>(vr::k_EButton_Axis0 + m_triggerAxisIndex));
-					}
+				// The trigger's touch/press state is held every frame, not only on frames where the axis moved
+				if (m_analogStage.IsTriggerTouched(0))
+				{
+					NewState.ulButtonTouched |= vr::ButtonMaskFromId(static_cast<vr::EVRButtonId>(vr::k_EButton_Axis0 + m_triggerAxisIndex));
+				}
 
-					vr::VRServerDriverHost()->TrackedDeviceAxisUpdated(m_unSteamVRTrackedDeviceId, m_triggerAxisIndex, NewState.rAxis[m_triggerAxisIndex]);
+				if (m_analogStage.IsTriggerPressed(0))
+				{
+					NewState.ulButtonPressed |= vr::ButtonMaskFromId(static_cast<vr::EVRButtonId>(vr::k_EButton_Axis0 + m_triggerAxisIndex));
 				}
 
+				// Trigger SteamVR Events
+				SendAxisUpdate(m_triggerAxisIndex, NewState, nowSeconds);
+
 				// Update the battery charge state
 				UpdateBatteryChargeState(m_PSMControllerView->ControllerState.PSMoveState.BatteryValue);
 			}
@@ -2183,126 +4797,67 @@ void CPSMoveControllerLatest::UpdateControllerState()
         {
             const PSMDualShock4 &clientView = m_PSMControllerView->ControllerState.PSDS4State;
 
-			const bool bStartRealignHMDTriggered =
-				(clientView.ShareButton == PSMButtonState_PRESSED && clientView.OptionsButton == PSMButtonState_PRESSED) ||
-				(clientView.ShareButton == PSMButtonState_PRESSED && clientView.OptionsButton == PSMButtonState_DOWN) ||
-				(clientView.ShareButton == PSMButtonState_DOWN && clientView.OptionsButton == PSMButtonState_PRESSED);
-
-			// See if the recenter button has been held for the requisite amount of time
-			bool bRecenterRequestTriggered = false;
-			{
-				PSMButtonState resetPoseButtonState = clientView.OptionsButton;
-
-				switch (resetPoseButtonState)
-				{
-				case PSMButtonState_PRESSED:
-					{
-						m_resetPoseButtonPressTime = std::chrono::high_resolution_clock::now();
-					} break;
-				case PSMButtonState_DOWN:
-				{
-					if (!m_bResetPoseRequestSent)
-					{
-						const float k_hold_duration_milli = 250.f;
-						std::chrono::time_point<std::chrono::high_resolution_clock> now = std::chrono::high_resolution_clock::now();
-						std::chrono::duration<float, std::milli> pressDurationMilli = now - m_resetPoseButtonPressTime;
-
-						if (pressDurationMilli.count() >= k_hold_duration_milli)
-						{
-							bRecenterRequestTriggered = true;
-						}
-					}
-				} break;
-				case PSMButtonState_RELEASED:
-					{
-						m_bResetPoseRequestSent = false;
-					} break;
-				}
-			}
+			const CPSMoveGestureEngine::eGestureAction gestureAction = 
+				m_gestureEngine.Update(m_PSMControllerView, nullptr, nowSeconds);
 
-			// If SHARE was just pressed while and OPTIONS was held or vice versa,
+			// If SHARE was just pressed while and OPTIONS was held or vice versa (or another realign gesture completed),
 			// recenter the controller orientation pose and start the realignment of the controller to HMD tracking space.
-			if (bStartRealignHMDTriggered)
+			if (gestureAction == CPSMoveGestureEngine::k_EGestureAction_RealignHMD)
 			{
 				#if LOG_REALIGN_TO_HMD != 0
 				DriverLog("CPSMoveControllerLatest::UpdateControllerState(): Calling StartRealignHMDTrackingSpace() in response to controller chord.\n");
 				#endif
 
 				PSM_ResetControllerOrientationAsync(m_PSMControllerView->ControllerID, k_psm_quaternion_identity, nullptr);
-				m_bResetPoseRequestSent = true;
 
 				StartRealignHMDTrackingSpace();
 			}
-			else if (bRecenterRequestTriggered)
+			else if (gestureAction == CPSMoveGestureEngine::k_EGestureAction_RecenterController)
 			{
 				DriverLog("CPSMoveControllerLatest::UpdateControllerState(): Calling ClientPSMoveAPI::reset_orientation() in response to controller button press.\n");
 
 				PSM_ResetControllerOrientationAsync(m_PSMControllerView->ControllerID, k_psm_quaternion_identity, nullptr);
-				m_bResetPoseRequestSent = true;
 			}
 			else
 			{
-				if (clientView.L1Button)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_L1]);
-				if (clientView.L2Button)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_L2]);
-				if (clientView.L3Button)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_L3]);
-				if (clientView.R1Button)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_R1]);
-				if (clientView.R2Button)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_R2]);
-				if (clientView.R3Button)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_R3]);
-
-				if (clientView.CircleButton)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_Circle]);
-				if (clientView.CrossButton)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_Cross]);
-				if (clientView.SquareButton)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_Square]);
-				if (clientView.TriangleButton)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_Triangle]);
-
-				if (clientView.DPadUpButton)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_Up]);
-				if (clientView.DPadDownButton)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_Down]);
-				if (clientView.DPadLeftButton)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_Left]);
-				if (clientView.DPadRightButton)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_Right]);
-
-				if (clientView.OptionsButton)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_Options]);
-				if (clientView.ShareButton)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_Share]);
-				if (clientView.TrackPadButton)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_Trackpad]);
-				if (clientView.PSButton)
-					NewState.ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[k_EPSControllerType_DS4][k_EPSButtonID_PS]);
+				ApplyInputMappings(false, &NewState);
 
 				NewState.rAxis[0].x = clientView.LeftAnalogX;
 				NewState.rAxis[0].y = -clientView.LeftAnalogY;
+				m_analogStage.ProcessStick(NewState.rAxis[0].x, NewState.rAxis[0].y);
 
-				NewState.rAxis[1].x = clientView.LeftTriggerValue;
+				NewState.rAxis[1].x = m_analogStage.ProcessTrigger(0, clientView.LeftTriggerValue);
 				NewState.rAxis[1].y = 0.f;
 
 				NewState.rAxis[2].x = clientView.RightAnalogX;
 				NewState.rAxis[2].y = -clientView.RightAnalogY;
+				m_analogStage.ProcessStick(NewState.rAxis[2].x, NewState.rAxis[2].y);
 
-				NewState.rAxis[3].x = clientView.RightTriggerValue;
+				NewState.rAxis[3].x = m_analogStage.ProcessTrigger(1, clientView.RightTriggerValue);
 				NewState.rAxis[3].y = 0.f;
 
-				if (NewState.rAxis[0].x != m_ControllerState.rAxis[0].x || NewState.rAxis[0].y != m_ControllerState.rAxis[0].y)
-					vr::VRServerDriverHost()->TrackedDeviceAxisUpdated(m_unSteamVRTrackedDeviceId, 0, NewState.rAxis[0]);
-				if (NewState.rAxis[1].x != m_ControllerState.rAxis[1].x)
-					vr::VRServerDriverHost()->TrackedDeviceAxisUpdated(m_unSteamVRTrackedDeviceId, 1, NewState.rAxis[1]);
+				// L2/R2 touch/press state comes from the trigger thresholds, held every frame like the PSMove trigger
+				static const int k_ds4TriggerAxisIndices[CPSMoveAnalogStage::k_maxTriggers] = { 1, 3 };
+				for (int triggerIndex = 0; triggerIndex < CPSMoveAnalogStage::k_maxTriggers; ++triggerIndex)
+				{
+					const vr::EVRButtonId axisButtonId = 
+						static_cast<vr::EVRButtonId>(vr::k_EButton_Axis0 + k_ds4TriggerAxisIndices[triggerIndex]);
+
+					if (m_analogStage.IsTriggerTouched(triggerIndex))
+					{
+						NewState.ulButtonTouched |= vr::ButtonMaskFromId(axisButtonId);
+					}
+
+					if (m_analogStage.IsTriggerPressed(triggerIndex))
+					{
+						NewState.ulButtonPressed |= vr::ButtonMaskFromId(axisButtonId);
+					}
+				}
 
-				if (NewState.rAxis[2].x != m_ControllerState.rAxis[2].x || NewState.rAxis[2].y != m_ControllerState.rAxis[2].y)
-					vr::VRServerDriverHost()->TrackedDeviceAxisUpdated(m_unSteamVRTrackedDeviceId, 2, NewState.rAxis[2]);
-				if (NewState.rAxis[3].x != m_ControllerState.rAxis[3].x)
-					vr::VRServerDriverHost()->TrackedDeviceAxisUpdated(m_unSteamVRTrackedDeviceId, 3, NewState.rAxis[3]);
+				SendAxisUpdate(0, NewState, nowSeconds);
+				SendAxisUpdate(1, NewState, nowSeconds);
+				SendAxisUpdate(2, NewState, nowSeconds);
+				SendAxisUpdate(3, NewState, nowSeconds);
 			}
         } break;
     }
@@ -2313,83 +4868,72 @@ void CPSMoveControllerLatest::UpdateControllerState()
     uint64_t ulChangedTouched = NewState.ulButtonTouched ^ m_ControllerState.ulButtonTouched;
     uint64_t ulChangedPressed = NewState.ulButtonPressed ^ m_ControllerState.ulButtonPressed;
 
-    SendButtonUpdates( &vr::IVRServerDriverHost::TrackedDeviceButtonTouched, ulChangedTouched & NewState.ulButtonTouched );
-    SendButtonUpdates( &vr::IVRServerDriverHost::TrackedDeviceButtonPressed, ulChangedPressed & NewState.ulButtonPressed );
-    SendButtonUpdates( &vr::IVRServerDriverHost::TrackedDeviceButtonUnpressed, ulChangedPressed & ~NewState.ulButtonPressed );
-    SendButtonUpdates( &vr::IVRServerDriverHost::TrackedDeviceButtonUntouched, ulChangedTouched & ~NewState.ulButtonTouched );
+	// All touches, then all presses, then all unpresses, then all untouches
+	if ( ulChangedTouched | ulChangedPressed )
+	{
+		++m_nButtonChangeFrameCount;
+
+		SendButtonUpdates( &vr::IVRServerDriverHost::TrackedDeviceButtonTouched, ulChangedTouched & NewState.ulButtonTouched );
+		SendButtonUpdates( &vr::IVRServerDriverHost::TrackedDeviceButtonPressed, ulChangedPressed & NewState.ulButtonPressed );
+		SendButtonUpdates( &vr::IVRServerDriverHost::TrackedDeviceButtonUnpressed, ulChangedPressed & ~NewState.ulButtonPressed );
+		SendButtonUpdates( &vr::IVRServerDriverHost::TrackedDeviceButtonUntouched, ulChangedTouched & ~NewState.ulButtonTouched );
+	}
 
     m_ControllerState = NewState;
 }
 
 
-void CPSMoveControllerLatest::UpdateControllerStateFromPsMoveButtonState(
-	ePSControllerType controllerType,
-	ePSButtonID buttonId,
-	PSMButtonState buttonState, 
+void CPSMoveControllerLatest::SendAxisUpdate(
+	uint32_t axisIndex, 
+	vr::VRControllerState_t &newState, 
+	double timeSeconds)
+{
+	if (m_axisEventFilter.FilterAxis(axisIndex, newState.rAxis[axisIndex], timeSeconds))
+	{
+		vr::VRServerDriverHost()->TrackedDeviceAxisUpdated(m_unSteamVRTrackedDeviceId, axisIndex, newState.rAxis[axisIndex]);
+	}
+}
+
+void CPSMoveControllerLatest::ApplyInputMappings(
+	bool bHasChildController,
 	vr::VRControllerState_t* pControllerStateToUpdate)
 {
-	if (buttonState & PSMButtonState_PRESSED || buttonState & PSMButtonState_DOWN)
+	const uint8_t *stateBase = reinterpret_cast<const uint8_t *>(&m_PSMControllerView->ControllerState);
+	const uint8_t *childStateBase = 
+		bHasChildController 
+		? reinterpret_cast<const uint8_t *>(&m_PSMChildControllerView->ControllerState) 
+		: nullptr;
+
+	uint64_t ulButtonPressed = 0;
+	uint64_t ulButtonTouched = 0;
+	uint8_t touchpadAxisMask = 0;
+
+	for (int entryIndex = 0; entryIndex < m_inputMappingCount; ++entryIndex)
 	{
-		if (psButtonIDToVRButtonID[controllerType][buttonId] == k_touchpadTouchMapping) {
-			pControllerStateToUpdate->ulButtonTouched |= vr::ButtonMaskFromId(vr::k_EButton_SteamVR_Touchpad);
-		}
-		else {
-			pControllerStateToUpdate->ulButtonPressed |= vr::ButtonMaskFromId(psButtonIDToVRButtonID[controllerType][buttonId]);
+		const InputMappingEntry &entry = m_inputMappings[entryIndex];
+		const uint8_t *base = entry.bIsChildButton ? childStateBase : stateBase;
 
-			if (psButtonIDToVrTouchpadDirection[controllerType][buttonId] == k_EVRTouchpadDirection_Left)
-			{
-				m_touchpadDirectionsUsed = true;
-				pControllerStateToUpdate->rAxis[0].x = -1.0f;
-				pControllerStateToUpdate->ulButtonPressed |= vr::ButtonMaskFromId(vr::k_EButton_SteamVR_Touchpad);
-			}
-			else if (psButtonIDToVrTouchpadDirection[controllerType][buttonId] == k_EVRTouchpadDirection_Right)
-			{
-				m_touchpadDirectionsUsed = true;
-				pControllerStateToUpdate->rAxis[0].x = 1.0f;
-				pControllerStateToUpdate->ulButtonPressed |= vr::ButtonMaskFromId(vr::k_EButton_SteamVR_Touchpad);
-			}
-			else if (psButtonIDToVrTouchpadDirection[controllerType][buttonId] == k_EVRTouchpadDirection_Up)
-			{
-				m_touchpadDirectionsUsed = true;
-				pControllerStateToUpdate->rAxis[0].y = 1.0f;
-				pControllerStateToUpdate->ulButtonPressed |= vr::ButtonMaskFromId(vr::k_EButton_SteamVR_Touchpad);
-			}
-			else if (psButtonIDToVrTouchpadDirection[controllerType][buttonId] == k_EVRTouchpadDirection_Down)
-			{
-				m_touchpadDirectionsUsed = true;
-				pControllerStateToUpdate->rAxis[0].y = -1.0f;
-				pControllerStateToUpdate->ulButtonPressed |= vr::ButtonMaskFromId(vr::k_EButton_SteamVR_Touchpad);
-			}
-			else if (psButtonIDToVrTouchpadDirection[controllerType][buttonId] == k_EVRTouchpadDirection_UpLeft)
-			{
-				m_touchpadDirectionsUsed = true;
-				pControllerStateToUpdate->rAxis[0].x = -0.707f;
-				pControllerStateToUpdate->rAxis[0].y = 0.707f;
-				pControllerStateToUpdate->ulButtonPressed |= vr::ButtonMaskFromId(vr::k_EButton_SteamVR_Touchpad);
-			}
-			else if (psButtonIDToVrTouchpadDirection[controllerType][buttonId] == k_EVRTouchpadDirection_UpRight)
-			{
-				m_touchpadDirectionsUsed = true;
-				pControllerStateToUpdate->rAxis[0].x = 0.707f;
-				pControllerStateToUpdate->rAxis[0].y = 0.707f;
-				pControllerStateToUpdate->ulButtonPressed |= vr::ButtonMaskFromId(vr::k_EButton_SteamVR_Touchpad);
-			}
-			else if (psButtonIDToVrTouchpadDirection[controllerType][buttonId] == k_EVRTouchpadDirection_DownLeft)
-			{
-				m_touchpadDirectionsUsed = true;
-				pControllerStateToUpdate->rAxis[0].x = -0.707f;
-				pControllerStateToUpdate->rAxis[0].y = -0.707f;
-				pControllerStateToUpdate->ulButtonPressed |= vr::ButtonMaskFromId(vr::k_EButton_SteamVR_Touchpad);
-			}
-			else if (psButtonIDToVrTouchpadDirection[controllerType][buttonId] == k_EVRTouchpadDirection_DownRight)
-			{
-				m_touchpadDirectionsUsed = true;
-				pControllerStateToUpdate->rAxis[0].x = 0.707f;
-				pControllerStateToUpdate->rAxis[0].y = -0.707f;
-				pControllerStateToUpdate->ulButtonPressed |= vr::ButtonMaskFromId(vr::k_EButton_SteamVR_Touchpad);
-			}
+		if (base == nullptr)
+			continue;
+
+		const PSMButtonState buttonState = *reinterpret_cast<const PSMButtonState *>(base + entry.stateOffset);
+
+		if ((buttonState & entry.stateMask) != 0)
+		{
+			ulButtonPressed |= entry.pressedMask;
+			ulButtonTouched |= entry.touchedMask;
+
+			if (entry.touchpadAxisMask & k_EInputMappingAxis_X)
+				pControllerStateToUpdate->rAxis[0].x = entry.touchpadX;
+			if (entry.touchpadAxisMask & k_EInputMappingAxis_Y)
+				pControllerStateToUpdate->rAxis[0].y = entry.touchpadY;
+			touchpadAxisMask |= entry.touchpadAxisMask;
 		}
 	}
+
+	pControllerStateToUpdate->ulButtonPressed |= ulButtonPressed;
+	pControllerStateToUpdate->ulButtonTouched |= ulButtonTouched;
+	m_touchpadDirectionsUsed = touchpadAxisMask != 0;
 }
 
 PSMQuatf ExtractHMDYawQuaternion(const PSMQuatf &q)
@@ -2471,6 +5015,8 @@ void CPSMoveControllerLatest::GetMetersPosInRotSpace(const PSMQuatf *rotation, P
 
 void CPSMoveControllerLatest::StartRealignHMDTrackingSpace()
 {
+	std::lock_guard<std::recursive_mutex> guard(g_ServerTrackedDeviceProvider.GetPSMClientMutex());
+
 	#if LOG_REALIGN_TO_HMD != 0
 		DriverLog( "Begin CPSMoveControllerLatest::StartRealignHMDTrackingSpace()\n" );
 	#endif
@@ -2486,6 +5032,7 @@ void CPSMoveControllerLatest::FinishRealignHMDTrackingSpace(
 	const PSMPosef &hmd_pose_raw_meters, 
 	void *userdata)
 {
+	std::lock_guard<std::recursive_mutex> guard(g_ServerTrackedDeviceProvider.GetPSMClientMutex());
 
 	CPSMoveControllerLatest* pThis = (CPSMoveControllerLatest*)userdata;
 
@@ -2591,181 +5138,304 @@ void CPSMoveControllerLatest::FinishRealignHMDTrackingSpace(
 	g_ServerTrackedDeviceProvider.SetHMDTrackingSpace(driver_pose_to_world_pose);
 }
 
-void CPSMoveControllerLatest::UpdateTrackingState()
+double CPSMoveControllerLatest::ComputeSampleAgeSeconds(
+	const std::chrono::time_point<std::chrono::high_resolution_clock> &now) const
 {
-    assert(m_PSMControllerView != nullptr);
-    assert(m_PSMControllerView->IsConnected);
+	// Prefer the time the client API received the data frame (milliseconds on the high_resolution_clock).
+	// Fall back to when we first noticed the new sequence number if that timestamp looks bogus.
+	const std::chrono::duration<double, std::milli> nowMilli = now.time_since_epoch();
+	const double receivedAgeMilli = nowMilli.count() - static_cast<double>(m_PSMControllerView->DataFrameLastReceivedTime);
+
+	double sampleAgeMilli;
+	if (m_PSMControllerView->DataFrameLastReceivedTime > 0 && 
+		receivedAgeMilli >= 0.0 && receivedAgeMilli <= k_maxSampleAgeMilliseconds)
+	{
+		sampleAgeMilli = receivedAgeMilli;
+	}
+	else
+	{
+		const std::chrono::duration<double, std::milli> timeSinceFirstSeen = now - m_lastNewSampleTime;
 
-	// The tracking status will be one of the following states:
-    m_Pose.result = m_trackingStatus;
+		sampleAgeMilli = fmin(fmax(timeSinceFirstSeen.count(), 0.0), k_maxSampleAgeMilliseconds);
+	}
 
-    m_Pose.deviceIsConnected = m_PSMControllerView->IsConnected;
+	return sampleAgeMilli / 1000.0;
+}
 
-    // These should always be false from any modern driver.  These are for Oculus DK1-like
-    // rotation-only tracking.  Support for that has likely rotted in vrserver.
-    m_Pose.willDriftInYaw = false;
-    m_Pose.shouldApplyHeadModel = false;
+bool CPSMoveControllerLatest::GatherLatestPose(
+	const std::chrono::time_point<std::chrono::high_resolution_clock> &now)
+{
+	if (!IsActivated() || !m_bIsListedByService || !m_PSMControllerView->IsConnected)
+		return false;
+
+	// Only send the pose to vrserver if we haven't already sent this sample
+	const int seq_num= m_PSMControllerView->OutputSequenceNum;
+	if (m_nPublishedPoseSequenceNumber == seq_num)
+		return false;
+
+	const PSMPosef *pose= nullptr;
+	const PSMPhysicsData *physicsData= nullptr;
+	bool bIsPoseValid= false;
+	switch (m_PSMControllerView->ControllerType)
+	{
+	case PSMControllerType::PSMController_Move:
+		{
+			const PSMPSMove &view= m_PSMControllerView->ControllerState.PSMoveState;
 
-    switch (m_PSMControllerView->ControllerType)
-    {
-    case PSMControllerType::PSMController_Move:
-        {
-            const PSMPSMove &view= m_PSMControllerView->ControllerState.PSMoveState;
+			pose= &view.Pose;
+			physicsData= &view.PhysicsData;
+			bIsPoseValid= view.bIsPositionValid && view.bIsOrientationValid;
+		} break;
+	case PSMControllerType::PSMController_DualShock4:
+		{
+			const PSMDualShock4 &view= m_PSMControllerView->ControllerState.PSDS4State;
+
+			pose= &view.Pose;
+			physicsData= &view.PhysicsData;
+			bIsPoseValid= view.bIsPositionValid && view.bIsOrientationValid;
+		} break;
+	}
 
-            // No prediction since that's already handled in the psmove service
-            m_Pose.poseTimeOffset = 0.f;
+	if (pose == nullptr)
+		return false;
 
-            // No transform due to the current HMD orientation
-            m_Pose.qDriverFromHeadRotation.w = 1.f;
-            m_Pose.qDriverFromHeadRotation.x = 0.0f;
-            m_Pose.qDriverFromHeadRotation.y = 0.0f;
-            m_Pose.qDriverFromHeadRotation.z = 0.0f;
-            m_Pose.vecDriverFromHeadTranslation[0] = 0.f;
-            m_Pose.vecDriverFromHeadTranslation[1] = 0.f;
-            m_Pose.vecDriverFromHeadTranslation[2] = 0.f;            
+	// Skip the whole pose pipeline while the controller is lying still
+	if (m_stationaryDetector.IsEnabled())
+	{
+		const bool bWasStationary= m_stationaryDetector.IsStationary();
+		bool bIsStationary= false;
 
-            // Set position
-            {
-                const PSMVector3f &position = view.Pose.Position;
+		if (bIsPoseValid)
+		{
+			const double timeSeconds= std::chrono::duration<double>(now.time_since_epoch()).count();
+			const PSMVector3f position= PSM_Vector3fScale(&pose->Position, k_fScalePSMoveAPIToMeters);
 
-                m_Pose.vecPosition[0] = position.x * k_fScalePSMoveAPIToMeters;
-                m_Pose.vecPosition[1] = position.y * k_fScalePSMoveAPIToMeters;
-                m_Pose.vecPosition[2] = position.z * k_fScalePSMoveAPIToMeters;
-            }
+			// The DS4's physics data is too noisy to judge stillness by, so it goes by the pose drift alone
+			float linearSpeed= 0.f;
+			float angularSpeed= 0.f;
+			if (m_PSMControllerView->ControllerType == PSMControllerType::PSMController_Move)
+			{
+				linearSpeed= PSM_Vector3fLength(&physicsData->LinearVelocityCmPerSec) * k_fScalePSMoveAPIToMeters;
+				angularSpeed= PSM_Vector3fLength(&physicsData->AngularVelocityRadPerSec);
+			}
+
+			bIsStationary= m_stationaryDetector.Update(timeSeconds, position, pose->Orientation, linearSpeed, angularSpeed);
+		}
+		else
+		{
+			m_stationaryDetector.Reset();
+		}
 
-			// virtual extend controllers
-			if (m_fVirtuallExtendControllersYMeters != 0.0f || m_fVirtuallExtendControllersZMeters != 0.0f)
+		if (bIsStationary)
+		{
+			const std::chrono::duration<float, std::milli> timeSinceFrozenPublish = 
+				now - m_lastFrozenPosePublishTime;
+
+			m_nPublishedPoseSequenceNumber = seq_num;
+
+			if (!bWasStationary || timeSinceFrozenPublish.count() >= m_fStationaryHeartbeatMilliseconds)
+			{
+				PublishFrozenPose(now);
+			}
+			else
 			{
-				const PSMQuatf &orientation = view.Pose.Orientation;
+				++m_nStationarySkippedPoseCount;
+			}
+
+			return false;
+		}
+		else if (bWasStationary)
+		{
+			// The history and the jitter filter weren't fed while frozen,
+			// so start them over rather than smoothing/fitting across the gap
+			m_poseHistory.Clear();
+			m_poseJitterFilter.Reset();
+		}
+	}
 
-				PSMVector3f shift = {(float)m_Pose.vecPosition[0], (float)m_Pose.vecPosition[1], (float)m_Pose.vecPosition[2]};
+	// Convert the sample straight into the driver pose (cm -> m, angular terms are already in radians)
+	{
+		const PSMVector3f position= PSM_Vector3fScale(&pose->Position, k_fScalePSMoveAPIToMeters);
+		const PSMVector3f linearVelocity= PSM_Vector3fScale(&physicsData->LinearVelocityCmPerSec, k_fScalePSMoveAPIToMeters);
+		const PSMVector3f linearAcceleration= PSM_Vector3fScale(&physicsData->LinearAccelerationCmPerSecSqr, k_fScalePSMoveAPIToMeters);
 
-				if (m_fVirtuallExtendControllersZMeters != 0.0f) {
+		m_Pose.vecPosition[0] = position.x;
+		m_Pose.vecPosition[1] = position.y;
+		m_Pose.vecPosition[2] = position.z;
 
-					PSMVector3f local_forward = {0, 0, -1};
-					PSMVector3f global_forward = PSM_QuatfRotateVector(&orientation, &local_forward);
+		m_Pose.qRotation.w = pose->Orientation.w;
+		m_Pose.qRotation.x = pose->Orientation.x;
+		m_Pose.qRotation.y = pose->Orientation.y;
+		m_Pose.qRotation.z = pose->Orientation.z;
 
-					shift = PSM_Vector3fScaleAndAdd(&global_forward, m_fVirtuallExtendControllersZMeters, &shift);
-				}
+		m_Pose.vecVelocity[0] = linearVelocity.x;
+		m_Pose.vecVelocity[1] = linearVelocity.y;
+		m_Pose.vecVelocity[2] = linearVelocity.z;
 
-				if (m_fVirtuallExtendControllersYMeters != 0.0f) {
+		m_Pose.vecAcceleration[0] = linearAcceleration.x;
+		m_Pose.vecAcceleration[1] = linearAcceleration.y;
+		m_Pose.vecAcceleration[2] = linearAcceleration.z;
 
-					PSMVector3f local_forward = {0, -1, 0};
-					PSMVector3f global_forward = PSM_QuatfRotateVector(&orientation, &local_forward);
+		m_Pose.vecAngularVelocity[0] = physicsData->AngularVelocityRadPerSec.x;
+		m_Pose.vecAngularVelocity[1] = physicsData->AngularVelocityRadPerSec.y;
+		m_Pose.vecAngularVelocity[2] = physicsData->AngularVelocityRadPerSec.z;
 
-					shift = PSM_Vector3fScaleAndAdd(&global_forward, m_fVirtuallExtendControllersYMeters, &shift);
-				}
+		m_Pose.vecAngularAcceleration[0] = physicsData->AngularAccelerationRadPerSecSqr.x;
+		m_Pose.vecAngularAcceleration[1] = physicsData->AngularAccelerationRadPerSecSqr.y;
+		m_Pose.vecAngularAcceleration[2] = physicsData->AngularAccelerationRadPerSecSqr.z;
 
-				m_Pose.vecPosition[0] = shift.x;
-				m_Pose.vecPosition[1] = shift.y;
-				m_Pose.vecPosition[2] = shift.z;
-			}
+		m_Pose.poseIsValid = bIsPoseValid;
+	}
 
-            // Set rotational coordinates
-            {
-                const PSMQuatf &orientation = view.Pose.Orientation;
+	m_nPublishedPoseSequenceNumber = seq_num;
+	m_lastNewSampleTime = now;
 
-                m_Pose.qRotation.w = orientation.w;
-                m_Pose.qRotation.x = orientation.x;
-                m_Pose.qRotation.y = orientation.y;
-                m_Pose.qRotation.z = orientation.z;
-            }
+	// How long ago the sample we are about to publish was taken.
+	// Reported as a negative pose time offset so that vrserver's own prediction covers the gap.
+	// (Any driver side prediction is extra lead on top of this to cover the latency upstream of the client)
+	m_Pose.poseTimeOffset = -ComputeSampleAgeSeconds(now);
 
-            // Set the physics state of the controller
-            {
-                const PSMPhysicsData &physicsData= view.PhysicsData;
+	return true;
+}
 
-                m_Pose.vecVelocity[0] = physicsData.LinearVelocityCmPerSec.x * k_fScalePSMoveAPIToMeters;
-                m_Pose.vecVelocity[1] = physicsData.LinearVelocityCmPerSec.y * k_fScalePSMoveAPIToMeters;
-                m_Pose.vecVelocity[2] = physicsData.LinearVelocityCmPerSec.z * k_fScalePSMoveAPIToMeters;
+void CPSMoveControllerLatest::FilterLatestPose(
+	const std::chrono::time_point<std::chrono::high_resolution_clock> &now)
+{
+	// Stamp the sample with the (high resolution) time of the publish pass that first saw it.
+	// The service's receive time is only in whole milliseconds, so frames arriving within
+	// the same millisecond would otherwise share a timestamp.
+	const double sampleTimeSeconds = 
+		std::chrono::duration<double>(now.time_since_epoch()).count();
+
+	PSMVector3f position = {
+		static_cast<float>(m_Pose.vecPosition[0]), 
+		static_cast<float>(m_Pose.vecPosition[1]), 
+		static_cast<float>(m_Pose.vecPosition[2])};
+	PSMQuatf orientation = {
+		static_cast<float>(m_Pose.qRotation.w), 
+		static_cast<float>(m_Pose.qRotation.x), 
+		static_cast<float>(m_Pose.qRotation.y), 
+		static_cast<float>(m_Pose.qRotation.z)};
+
+	// Record the raw pose (invalid ones too, so that readers can see the tracking gaps)
+	{
+		CPSMovePoseHistory::Sample sample;
 
-                m_Pose.vecAcceleration[0] = physicsData.LinearAccelerationCmPerSecSqr.x * k_fScalePSMoveAPIToMeters;
-                m_Pose.vecAcceleration[1] = physicsData.LinearAccelerationCmPerSecSqr.y * k_fScalePSMoveAPIToMeters;
-                m_Pose.vecAcceleration[2] = physicsData.LinearAccelerationCmPerSecSqr.z * k_fScalePSMoveAPIToMeters;
+		sample.timeSeconds = sampleTimeSeconds;
+		sample.position = position;
+		sample.orientation = orientation;
+		sample.bIsValid = m_Pose.poseIsValid;
+		m_poseHistory.AddSample(sample);
+	}
 
-                m_Pose.vecAngularVelocity[0] = physicsData.AngularVelocityRadPerSec.x;
-                m_Pose.vecAngularVelocity[1] = physicsData.AngularVelocityRadPerSec.y;
-                m_Pose.vecAngularVelocity[2] = physicsData.AngularVelocityRadPerSec.z;
+	if (!m_Pose.poseIsValid)
+	{
+		// Don't smooth across a tracking gap
+		m_poseJitterFilter.Reset();
 
-                m_Pose.vecAngularAcceleration[0] = physicsData.AngularAccelerationRadPerSecSqr.x;
-                m_Pose.vecAngularAcceleration[1] = physicsData.AngularAccelerationRadPerSecSqr.y;
-                m_Pose.vecAngularAcceleration[2] = physicsData.AngularAccelerationRadPerSecSqr.z;
-            }
+		if (m_PSMControllerView->ControllerType == PSMControllerType::PSMController_DualShock4)
+		{
+			SetDriverPoseVelocities(*k_psm_float_vector3_zero, *k_psm_float_vector3_zero);
+		}
+		return;
+	}
 
-            m_Pose.poseIsValid = 
-				m_PSMControllerView->ControllerState.PSMoveState.bIsPositionValid && 
-				m_PSMControllerView->ControllerState.PSMoveState.bIsOrientationValid;
+	// The physics data from the service is too noisy for the DS4 (causes jitter),
+	// so the velocities are reconstructed from a line fit over the recent (unfiltered) poses instead.
+	if (m_PSMControllerView->ControllerType == PSMControllerType::PSMController_DualShock4)
+	{
+		PSMVector3f linearVelocity;
+		PSMVector3f angularVelocity;
 
-            // This call posts this pose to shared memory, where all clients will have access to it the next
-            // moment they want to predict a pose.
-			vr::VRServerDriverHost()->TrackedDevicePoseUpdated( m_unSteamVRTrackedDeviceId, m_Pose, sizeof( vr::DriverPose_t ) );
-        } break;
-    case PSMControllerType::PSMController_DualShock4:
-        {
-            const PSMDualShock4 &view = m_PSMControllerView->ControllerState.PSDS4State;
+		m_velocityEstimator.ComputeVelocities(m_poseHistory, linearVelocity, angularVelocity);
+		SetDriverPoseVelocities(linearVelocity, angularVelocity);
+	}
 
-            // No prediction since that's already handled in the psmove service
-            m_Pose.poseTimeOffset = 0.f;
+	// Smooth out the optical jitter before the prediction is derived from the pose
+	if (m_poseJitterFilter.IsEnabled())
+	{
+		m_poseJitterFilter.Apply(sampleTimeSeconds, position, orientation);
 
-            // Rotate -90 degrees about the x-axis from the current HMD orientation
-            m_Pose.qDriverFromHeadRotation.w = 1.f;
-            m_Pose.qDriverFromHeadRotation.x = 0.0f;
-            m_Pose.qDriverFromHeadRotation.y = 0.0f;
-            m_Pose.qDriverFromHeadRotation.z = 0.0f;
-            m_Pose.vecDriverFromHeadTranslation[0] = 0.f;
-            m_Pose.vecDriverFromHeadTranslation[1] = 0.f;
-            m_Pose.vecDriverFromHeadTranslation[2] = 0.f;
+		m_Pose.vecPosition[0] = position.x;
+		m_Pose.vecPosition[1] = position.y;
+		m_Pose.vecPosition[2] = position.z;
 
-            // Set position
-            {
-                const PSMVector3f &position = view.Pose.Position;
+		m_Pose.qRotation.w = orientation.w;
+		m_Pose.qRotation.x = orientation.x;
+		m_Pose.qRotation.y = orientation.y;
+		m_Pose.qRotation.z = orientation.z;
+	}
+}
 
-                m_Pose.vecPosition[0] = position.x * k_fScalePSMoveAPIToMeters;
-                m_Pose.vecPosition[1] = position.y * k_fScalePSMoveAPIToMeters;
-                m_Pose.vecPosition[2] = position.z * k_fScalePSMoveAPIToMeters;
-            }
+void CPSMoveControllerLatest::SetDriverPoseVelocities(
+	const PSMVector3f &linearVelocity, 
+	const PSMVector3f &angularVelocity)
+{
+	// Accelerations derived from reconstructed velocities would be too noisy, so they are dropped
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		m_Pose.vecAcceleration[axis] = 0.0;
+		m_Pose.vecAngularAcceleration[axis] = 0.0;
+	}
 
-            // Set rotational coordinates
-            {
-                const PSMQuatf &orientation = view.Pose.Orientation;
+	m_Pose.vecVelocity[0] = linearVelocity.x;
+	m_Pose.vecVelocity[1] = linearVelocity.y;
+	m_Pose.vecVelocity[2] = linearVelocity.z;
 
-                m_Pose.qRotation.w = orientation.w;
-                m_Pose.qRotation.x = orientation.x;
-                m_Pose.qRotation.y = orientation.y;
-                m_Pose.qRotation.z = orientation.z;
-            }
+	m_Pose.vecAngularVelocity[0] = angularVelocity.x;
+	m_Pose.vecAngularVelocity[1] = angularVelocity.y;
+	m_Pose.vecAngularVelocity[2] = angularVelocity.z;
+}
 
-            // Set the physics state of the controller
-            // TODO: Physics data is too noisy for the DS4 right now, causes jitter
-            {
-                const PSMPhysicsData &physicsData= view.PhysicsData;
+void CPSMoveControllerLatest::PublishFrozenPose(
+	const std::chrono::time_point<std::chrono::high_resolution_clock> &now)
+{
+	// Re-send the last published pose, but at rest, so vrserver doesn't extrapolate it anywhere
+	m_Pose.result = m_trackingStatus;
+	m_Pose.poseTimeOffset = 0.0;
 
-                m_Pose.vecVelocity[0] = 0.f; // physicsData.Velocity.i * k_fScalePSMoveAPIToMeters;
-                m_Pose.vecVelocity[1] = 0.f; // physicsData.Velocity.j * k_fScalePSMoveAPIToMeters;
-                m_Pose.vecVelocity[2] = 0.f; // physicsData.Velocity.k * k_fScalePSMoveAPIToMeters;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		m_Pose.vecVelocity[axis] = 0.0;
+		m_Pose.vecAcceleration[axis] = 0.0;
+		m_Pose.vecAngularVelocity[axis] = 0.0;
+		m_Pose.vecAngularAcceleration[axis] = 0.0;
+	}
 
-                m_Pose.vecAcceleration[0] = 0.f; // physicsData.Acceleration.i * k_fScalePSMoveAPIToMeters;
-                m_Pose.vecAcceleration[1] = 0.f; // physicsData.Acceleration.j * k_fScalePSMoveAPIToMeters;
-                m_Pose.vecAcceleration[2] = 0.f; // physicsData.Acceleration.k * k_fScalePSMoveAPIToMeters;
+	vr::VRServerDriverHost()->TrackedDevicePoseUpdated( m_unSteamVRTrackedDeviceId, m_Pose, sizeof( vr::DriverPose_t ) );
 
-                m_Pose.vecAngularVelocity[0] = 0.f; // physicsData.AngularVelocity.i;
-                m_Pose.vecAngularVelocity[1] = 0.f; // physicsData.AngularVelocity.j;
-                m_Pose.vecAngularVelocity[2] = 0.f; // physicsData.AngularVelocity.k;
+	m_lastFrozenPosePublishTime = now;
+}
 
-                m_Pose.vecAngularAcceleration[0] = 0.f; // physicsData.AngularAcceleration.i;
-                m_Pose.vecAngularAcceleration[1] = 0.f; // physicsData.AngularAcceleration.j;
-                m_Pose.vecAngularAcceleration[2] = 0.f; // physicsData.AngularAcceleration.k;
-            }
+void CPSMoveControllerLatest::PublishLatestPose()
+{
+	// The tracking status will be one of the following states:
+    m_Pose.result = m_trackingStatus;
 
-            m_Pose.poseIsValid =
-				m_PSMControllerView->ControllerState.PSDS4State.bIsPositionValid && 
-				m_PSMControllerView->ControllerState.PSDS4State.bIsOrientationValid;
+    m_Pose.deviceIsConnected = m_PSMControllerView->IsConnected;
 
-            // This call posts this pose to shared memory, where all clients will have access to it the next
-            // moment they want to predict a pose.
-			vr::VRServerDriverHost()->TrackedDevicePoseUpdated( m_unSteamVRTrackedDeviceId, m_Pose, sizeof( vr::DriverPose_t ) );
-        } break;
-    }
+    // These should always be false from any modern driver.  These are for Oculus DK1-like
+    // rotation-only tracking.  Support for that has likely rotted in vrserver.
+    m_Pose.willDriftInYaw = false;
+    m_Pose.shouldApplyHeadModel = false;
+
+    // The precomposed local offset (grip/tip frame) of this controller.
+	// vrserver applies it on top of the pose (and its prediction), so it costs us nothing per frame.
+    m_Pose.qDriverFromHeadRotation = m_qLocalOffsetRotation;
+    m_Pose.vecDriverFromHeadTranslation[0] = m_vecLocalOffsetTranslation[0];
+    m_Pose.vecDriverFromHeadTranslation[1] = m_vecLocalOffsetTranslation[1];
+    m_Pose.vecDriverFromHeadTranslation[2] = m_vecLocalOffsetTranslation[2];
+
+	// GatherLatestPose() already wrote the pose (in meters) and its sample age (poseTimeOffset),
+	// cover the tracking pipeline latency the service doesn't compensate for
+	if (m_fPosePredictionSeconds > 0.f)
+	{
+		ExtrapolateDriverPose(m_Pose, m_fPosePredictionSeconds);
+	}
+
+    // This call posts this pose to shared memory, where all clients will have access to it the next
+    // moment they want to predict a pose.
+	vr::VRServerDriverHost()->TrackedDevicePoseUpdated( m_unSteamVRTrackedDeviceId, m_Pose, sizeof( vr::DriverPose_t ) );
 }
 
 void CPSMoveControllerLatest::UpdateRumbleState()
@@ -2888,16 +5558,16 @@ void CPSMoveControllerLatest::Update()
 {
     CPSMoveTrackedDeviceLatest::Update();
 
-    if (IsActivated() && m_PSMControllerView->IsConnected)
+    if (IsActivated() && m_bIsListedByService && m_PSMControllerView->IsConnected)
     {
         int seq_num= m_PSMControllerView->OutputSequenceNum;
 
         // Only other updating incoming state if it actually changed
+		// (the pose itself was already sent out by the server's PublishControllerPoses())
         if (m_nPoseSequenceNumber != seq_num)
         {
             m_nPoseSequenceNumber = seq_num;
 
-            UpdateTrackingState();
             UpdateControllerState();
         }
 
@@ -2918,12 +5588,25 @@ void CPSMoveControllerLatest::RefreshWorldFromDriverPose()
 bool CPSMoveControllerLatest::AttachChildPSMController(
 	int ChildControllerId,
 	PSMControllerType ChildControllerType,
-	const std::string &ChildControllerSerialNo)
+	const char *ChildControllerSerialNo)
 {
 	bool bSuccess= false;
 
-	if (m_nPSMChildControllerId == -1 && 
-		m_nPSMChildControllerId != m_nPSMControllerId && 
+	// Already attached (every controller list update re-attaches the navi)
+	if (m_nPSMChildControllerId == ChildControllerId)
+		return true;
+
+	// The service renumbered the navi
+	if (m_nPSMChildControllerId != -1)
+	{
+		PSM_StopControllerDataStreamAsync(m_nPSMChildControllerId, nullptr);
+		PSM_FreeControllerListener(m_nPSMChildControllerId);
+		m_nPSMChildControllerId= -1;
+		m_PSMChildControllerType= PSMControllerType::PSMController_None;
+		m_PSMChildControllerView= nullptr;
+	}
+
+	if (ChildControllerId != m_nPSMControllerId && 
 		PSM_AllocateControllerListener(ChildControllerId) == PSMResult_Success)
 	{
 		m_nPSMChildControllerId= ChildControllerId;
@@ -2952,6 +5635,10 @@ bool CPSMoveControllerLatest::AttachChildPSMController(
 CPSMoveTrackerLatest::CPSMoveTrackerLatest(const PSMClientTrackerInfo *trackerInfo)
     : CPSMoveTrackedDeviceLatest()
     , m_nTrackerId(trackerInfo->tracker_id)
+	, m_bPoseDirty(true)
+	, m_lastPosePublishTime()
+	, m_nPosePublishCount(0)
+	, m_nPosePublishSkipCount(0)
 {
     char buf[256];
     GenerateTrackerSerialNumber(buf, sizeof(buf), trackerInfo->tracker_id);
@@ -2966,6 +5653,7 @@ CPSMoveTrackerLatest::~CPSMoveTrackerLatest()
 
 vr::EVRInitError CPSMoveTrackerLatest::Activate(uint32_t unObjectId)
 {
+	std::lock_guard<std::recursive_mutex> guard(g_ServerTrackedDeviceProvider.GetPSMClientMutex());
     vr::EVRInitError result = CPSMoveTrackedDeviceLatest::Activate(unObjectId);
 
     if (result == vr::VRInitError_None)
@@ -3009,6 +5697,7 @@ vr::EVRInitError CPSMoveTrackerLatest::Activate(uint32_t unObjectId)
 
 void CPSMoveTrackerLatest::Deactivate()
 {
+	std::lock_guard<std::recursive_mutex> guard(g_ServerTrackedDeviceProvider.GetPSMClientMutex());
 }
 
 void CPSMoveTrackerLatest::SetClientTrackerInfo(
@@ -3062,15 +5751,87 @@ void CPSMoveTrackerLatest::SetClientTrackerInfo(
     }
 
     m_Pose.poseIsValid = true;
+
+	m_bPoseDirty = true;
+}
+
+void CPSMoveTrackerLatest::RefreshWorldFromDriverPose()
+{
+	CPSMoveTrackedDeviceLatest::RefreshWorldFromDriverPose();
+
+	m_bPoseDirty = true;
 }
 
 void CPSMoveTrackerLatest::Update()
 {
     CPSMoveTrackedDeviceLatest::Update();
 
-    // This call posts this pose to shared memory, where all clients will have access to it the next
-    // moment they want to predict a pose.
-	vr::VRServerDriverHost()->TrackedDevicePoseUpdated( m_unSteamVRTrackedDeviceId, m_Pose, sizeof( vr::DriverPose_t ) );
+	if (!IsActivated())
+		return;
+
+	// The tracker doesn't move, so only re-send the pose when it changed.
+	// The heartbeat covers vrserver dropping the device's pose for going stale.
+	const std::chrono::time_point<std::chrono::high_resolution_clock> now = std::chrono::high_resolution_clock::now();
+	const std::chrono::duration<float, std::milli> timeSinceLastPublish = now - m_lastPosePublishTime;
+
+	if (m_bPoseDirty || timeSinceLastPublish.count() >= k_trackerPoseHeartbeatMilliseconds)
+	{
+		// This call posts this pose to shared memory, where all clients will have access to it the next
+		// moment they want to predict a pose.
+		vr::VRServerDriverHost()->TrackedDevicePoseUpdated( m_unSteamVRTrackedDeviceId, m_Pose, sizeof( vr::DriverPose_t ) );
+
+		m_bPoseDirty = false;
+		m_lastPosePublishTime = now;
+		++m_nPosePublishCount;
+	}
+	else
+	{
+		++m_nPosePublishSkipCount;
+	}
+}
+
+void CPSMoveTrackerLatest::DebugRequest(
+    const char * pchRequest,
+    char * pchResponseBuffer,
+    uint32_t unResponseBufferSize)
+{
+	std::lock_guard<std::recursive_mutex> guard(g_ServerTrackedDeviceProvider.GetPSMClientMutex());
+	std::istringstream ss( pchRequest );
+	std::string strCmd;
+
+	ss >> strCmd;
+	if (strCmd == "psmove:tracker_stats")
+	{
+		// Reports how many redundant pose updates were not sent to vrserver
+		if (pchResponseBuffer != nullptr && unResponseBufferSize > 0)
+		{
+			snprintf(pchResponseBuffer, unResponseBufferSize,
+				"pose_updates_sent=%llu pose_updates_skipped=%llu",
+				m_nPosePublishCount, m_nPosePublishSkipCount);
+			pchResponseBuffer[unResponseBufferSize - 1] = '\0';
+		}
+	}
+	else
+	{
+		CPSMoveTrackedDeviceLatest::DebugRequest(pchRequest, pchResponseBuffer, unResponseBufferSize);
+	}
+}
+
+void CPSMoveTrackerLatest::EnterReconnectingState()
+{
+	// Still connected as far as vrserver is concerned until the next tracker list says otherwise
+	m_Pose.result = vr::TrackingResult_Running_OutOfRange;
+
+	m_bPoseDirty = true;
+}
+
+void CPSMoveTrackerLatest::SetRemovedFromService()
+{
+	m_Pose.result = vr::TrackingResult_Uninitialized;
+	m_Pose.deviceIsConnected = false;
+	m_Pose.poseIsValid = false;
+
+	m_bPoseDirty = true;
 }
 
 bool CPSMoveTrackerLatest::HasTrackerId(int TrackerID)
@@ -4,17 +4,66 @@
 #include <openvr_driver.h>
 #include <string>
 #include <vector>
+#include <deque>
 #include <chrono>
 #include <atomic>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <random>
 
 #include "PSMoveClient_CAPI.h"
 
 //-- pre-declarations -----
 class CPSMoveTrackedDeviceLatest;
+class CPSMoveControllerLatest;
+class CPSMoveTrackerLatest;
 
 //-- definitions -----
+
+// Decides when to next try reconnecting to PSMoveService after a failed attempt or a disconnect.
+// The delay doubles after every failure up to a cap, with some random jitter so that
+// several clients don't all hammer a restarting service at the same moment.
+class CPSMoveReconnectScheduler
+{
+public:
+	CPSMoveReconnectScheduler();
+
+	void SetLimits(int initialDelayMilliseconds, int maxDelayMilliseconds, float jitterFraction);
+
+	void OnAttempt();
+	void OnAttemptFailed();
+	void OnConnected();
+	void OnDisconnected();
+
+	inline bool IsRetryPending() const { return m_bIsRetryPending; }
+	bool IsRetryDue() const;
+	inline int GetCurrentDelayMilliseconds() const { return m_currentDelayMilliseconds; }
+
+	// Stats
+	inline unsigned long long GetAttemptCount() const { return m_nAttemptCount; }
+	inline unsigned long long GetConnectCount() const { return m_nConnectCount; }
+	inline double GetLastTimeToConnectSeconds() const { return m_lastTimeToConnectSeconds; }
+	inline double GetMaxTimeToConnectSeconds() const { return m_maxTimeToConnectSeconds; }
+
+private:
+	int m_initialDelayMilliseconds;
+	int m_maxDelayMilliseconds;
+	float m_jitterFraction;
+
+	int m_nextBackoffMilliseconds;
+	int m_currentDelayMilliseconds;
+	bool m_bIsRetryPending;
+	bool m_bIsOutageInProgress;
+	std::chrono::time_point<std::chrono::high_resolution_clock> m_retryTime;
+	std::chrono::time_point<std::chrono::high_resolution_clock> m_outageStartTime;
+	std::minstd_rand m_randomGenerator;
+
+	unsigned long long m_nAttemptCount;
+	unsigned long long m_nConnectCount;
+	double m_lastTimeToConnectSeconds;
+	double m_maxTimeToConnectSeconds;
+};
 class CWatchdogDriver_PSMoveService : public vr::IVRWatchdogProvider
 {
 public:
@@ -26,6 +75,7 @@ public:
 
 protected:
 	void WorkerThreadFunction();
+	bool WaitForExitSignal(const std::chrono::milliseconds &timeout);
 	void WatchdogLogVarArgs( const char *pMsgFormat, va_list args );
 	void WatchdogLog( const char *pMsgFormat, ... );
 
@@ -35,69 +85,100 @@ private:
 
 	bool m_bWasConnected;
 	std::atomic_bool m_bExitSignaled;
+	std::mutex m_exitSignalMutex;
+	std::condition_variable m_exitSignalCondition;
     std::thread *m_pWatchdogThread;
 
+	// How often the connection is polled for a system button press
+	int m_pollIntervalMilliseconds;
+
+	// Paces connection attempts while the service is unreachable
+	CPSMoveReconnectScheduler m_reconnectScheduler;
+
 	std::string m_strPSMoveServiceAddress;
 	std::string m_strServerPort;
 
 	PSMControllerList controllerList;
 };
 
-class CServerDriver_PSMoveService : public vr::IServerTrackedDeviceProvider
+// Routes the responses and events polled from the client API to the handlers registered
+// for each event type / response payload type, keeping a count and the cumulative
+// handling time per type.
+class CPSMoveMessageDispatcher
 {
 public:
-    CServerDriver_PSMoveService();
-    virtual ~CServerDriver_PSMoveService();
+	typedef void (*MessageHandler)(const PSMMessage *message, void *userdata);
 
-    // Inherited via IServerTrackedDeviceProvider
-    virtual vr::EVRInitError Init( vr::IVRDriverContext *pDriverContext ) override;
-    virtual void Cleanup() override;
-    virtual const char * const *GetInterfaceVersions() override;
-    virtual void RunFrame() override;
-    virtual bool ShouldBlockStandbyMode() override;
-    virtual void EnterStandby() override;
-    virtual void LeaveStandby() override;
+	static const int k_maxEventTypes = 16;
+	static const int k_maxResponseTypes = PSMResponseMessage::_responsePayloadType_Count;
 
-    void LaunchPSMoveMonitor();
+	CPSMoveMessageDispatcher();
 
-	void SetHMDTrackingSpace(const PSMPosef &origin_pose);
-    inline PSMPosef GetWorldFromDriverPose() const { return m_worldFromDriverPose; }
+	bool RegisterEventHandler(PSMEventMessage::eEventType eventType, MessageHandler handler, void *userdata);
+	bool RegisterResponseHandler(PSMResponseMessage::eResponsePayloadType payloadType, MessageHandler handler, void *userdata);
+	void Dispatch(const PSMMessage *message);
+
+	void GetStats(char *pchResponseBuffer, uint32_t unResponseBufferSize) const;
 
 private:
-    vr::ITrackedDeviceServerDriver * FindTrackedDeviceDriver(const char * pchId);
-    void AllocateUniquePSMoveController(PSMControllerID ControllerID, const std::string &ControllerSerial);
-    void AttachPSNaviToParentController(PSMControllerID ControllerID, const std::string &ControllerSerial, const std::string &ParentControllerSerial);
-    void AllocateUniqueDualShock4Controller(PSMControllerID ControllerID, const std::string &ControllerSerial);
-    void AllocateUniquePSMoveTracker(const PSMClientTrackerInfo *trackerInfo);
-    bool ReconnectToPSMoveService();
+	struct HandlerEntry
+	{
+		MessageHandler handler;
+		void *userdata;
+		unsigned long long invocationCount;
+		double totalSeconds;
+	};
 
-    // Event Handling
-    void HandleClientPSMoveEvent(const PSMMessage *event);
-    void HandleConnectedToPSMoveService();
-    void HandleFailedToConnectToPSMoveService();
-    void HandleDisconnectedFromPSMoveService();
-	static void HandleServiceVersionResponse(const PSMResponseMessage *response, void *userdata);
-    void HandleControllerListChanged();
-    void HandleTrackerListChanged();
+	static void InvokeHandler(HandlerEntry &entry, const PSMMessage *message);
 
-    // Response Handling
-    void HandleClientPSMoveResponse(const PSMMessage *message);
-    void HandleControllerListReponse(const PSMControllerList *controller_list, const PSMResponseHandle response_handle);
-    void HandleTrackerListReponse(const PSMTrackerList *tracker_list);
-    
-    void LaunchPSMoveMonitor_Internal( const char * pchDriverInstallDir );
+	HandlerEntry m_eventHandlers[k_maxEventTypes];
+	HandlerEntry m_responseHandlers[k_maxResponseTypes];
+	unsigned long long m_nUnknownMessageCount;
+};
 
-	std::string m_strPSMoveHMDSerialNo;
-	std::string m_strPSMoveServiceAddress;
-	std::string m_strServerPort;
+// Constant time lookups of the tracked devices by PSM controller/tracker id, controller serial and SteamVR identifier.
+// Ids index fixed arrays directly. Serials and identifiers go through small open addressing hash tables
+// keyed on fixed size upper case copies of the strings, so lookups never allocate.
+// Doesn't own the devices.
+class CPSMoveTrackedDeviceRegistry
+{
+public:
+	static const int k_maxKeyLength = 64;
+	static const int k_hashTableSize = 32; // power of two, comfortably more than the device count
 
-    bool m_bLaunchedPSMoveMonitor;
-	bool m_bInitialized;
+	CPSMoveTrackedDeviceRegistry();
 
-    std::vector< CPSMoveTrackedDeviceLatest * > m_vecTrackedDevices;
+	void Clear();
+	bool AddController(CPSMoveControllerLatest *pController);
+	bool AddTracker(CPSMoveTrackerLatest *pTracker);
 
-    // HMD Tracking Space
-    PSMPosef m_worldFromDriverPose;
+	// PSM controller ids can be renumbered by the service while the serial stays the same
+	void BindControllerId(CPSMoveControllerLatest *pController, PSMControllerID controllerId);
+	void UnbindControllerId(PSMControllerID controllerId, const CPSMoveControllerLatest *pController);
+
+	CPSMoveControllerLatest *FindControllerById(PSMControllerID controllerId) const;
+	CPSMoveTrackerLatest *FindTrackerById(PSMTrackerID trackerId) const;
+	CPSMoveControllerLatest *FindControllerBySerial(const char *pchSerial) const;
+	CPSMoveTrackedDeviceLatest *FindDeviceBySteamVRIdentifier(const char *pchIdentifier) const;
+
+	// Upper case copy of a serial/identifier, as used for the keys.
+	// Returns false if it doesn't fit (such a key can't be in the registry either).
+	static bool NormalizeKey(const char *pchKey, char *pchOutKey, size_t outKeySize);
+
+private:
+	struct HashEntry
+	{
+		char key[k_maxKeyLength];
+		CPSMoveTrackedDeviceLatest *pDevice;
+	};
+
+	static bool InsertKey(HashEntry *table, const char *pchKey, CPSMoveTrackedDeviceLatest *pDevice);
+	static CPSMoveTrackedDeviceLatest *LookupKey(const HashEntry *table, const char *pchKey);
+
+	CPSMoveControllerLatest *m_controllersById[PSMOVESERVICE_MAX_CONTROLLER_COUNT];
+	CPSMoveTrackerLatest *m_trackersById[PSMOVESERVICE_MAX_TRACKER_COUNT];
+	HashEntry m_serialTable[k_hashTableSize];
+	HashEntry m_identifierTable[k_hashTableSize];
 };
 
 class CPSMoveTrackedDeviceLatest : public vr::ITrackedDeviceServerDriver
@@ -147,7 +228,288 @@ protected:
 	void *m_hmdResultUserData;
 };
 
-class CPSMoveControllerLatest : public CPSMoveTrackedDeviceLatest, public vr::IVRControllerComponent
+// Fixed capacity history of the recent raw poses of a controller.
+// Only the pose publishing path writes to it, but any thread can read it without locking:
+// each slot is guarded by its own sequence counter (a seqlock) and readers simply retry
+// when they race with the writer.
+class CPSMovePoseHistory
+{
+public:
+	static const int k_capacity = 64;
+
+	struct Sample
+	{
+		double timeSeconds;
+		PSMVector3f position; // meters
+		PSMQuatf orientation;
+		bool bIsValid;
+	};
+
+	CPSMovePoseHistory();
+
+	// Writer interface (pose publishing path only)
+	bool AddSample(const Sample &sample);
+	void Clear();
+
+	// Reader interface (any thread)
+	int GetSampleCount() const;
+	bool GetSample(int age, Sample &outSample) const; // age 0 is the newest sample
+	bool GetLatestAgeSeconds(double nowSeconds, double &outAgeSeconds) const;
+	bool SampleAtTime(double timeSeconds, Sample &outSample) const;
+	inline unsigned long long GetReplacedSampleCount() const { return m_nReplacedSampleCount; }
+	inline unsigned long long GetDroppedSampleCount() const { return m_nDroppedSampleCount; }
+
+private:
+	struct Slot
+	{
+		std::atomic<uint32_t> sequence;
+		uint64_t writeIndex;
+		Sample sample;
+	};
+
+	bool ReadSlot(uint64_t writeIndex, Sample &outSample) const;
+
+	Slot m_slots[k_capacity];
+	std::atomic<uint64_t> m_writeCount;
+	std::atomic<uint64_t> m_firstReadableIndex;
+
+	// Samples that replaced the newest one (same timestamp) or were too old to add
+	unsigned long long m_nReplacedSampleCount;
+	unsigned long long m_nDroppedSampleCount;
+};
+
+// Reconstructs linear and angular velocity from the newest poses in a pose history
+// using a least squares line fit. Used for controllers whose physics data is too noisy to forward.
+class CPSMoveVelocityEstimator
+{
+public:
+	static const int k_maxWindowSize = 16;
+
+	CPSMoveVelocityEstimator();
+
+	void SetWindowSize(int windowSize);
+	inline int GetWindowSize() const { return m_windowSize; }
+
+	bool ComputeVelocities(const CPSMovePoseHistory &history, PSMVector3f &outLinearVelocity, PSMVector3f &outAngularVelocity) const;
+
+private:
+	int m_windowSize;
+};
+
+// Speed adaptive low pass filter for the optical pose ("One Euro" filter).
+// The cutoff frequency rises with the filtered speed of the controller, so the pose is
+// smoothed heavily while held still and passes through nearly untouched during fast motion.
+class CPSMovePoseJitterFilter
+{
+public:
+	CPSMovePoseJitterFilter();
+
+	void SetParameters(float minCutoffHz, float positionBeta, float rotationBeta, float derivativeCutoffHz);
+	inline void SetEnabled(bool bEnabled) { m_bEnabled = bEnabled; Reset(); }
+	inline bool IsEnabled() const { return m_bEnabled; }
+	void Reset();
+
+	// Position in meters, time in seconds. Filters the pose in place.
+	void Apply(double timeSeconds, PSMVector3f &inOutPosition, PSMQuatf &inOutOrientation);
+
+	// Latency added by the filter, estimated from the cutoff used for each sample
+	inline double GetLastPositionLagSeconds() const { return m_lastPositionLagSeconds; }
+	inline double GetLastRotationLagSeconds() const { return m_lastRotationLagSeconds; }
+	double GetAveragePositionLagSeconds() const;
+	double GetAverageRotationLagSeconds() const;
+	inline int GetFilteredSampleCount() const { return m_filteredSampleCount; }
+
+private:
+	bool m_bEnabled;
+	float m_minCutoffHz;
+	float m_positionBeta;
+	float m_rotationBeta;
+	float m_derivativeCutoffHz;
+
+	bool m_bHasPreviousSample;
+	double m_previousTimeSeconds;
+	PSMVector3f m_filteredPosition;
+	PSMQuatf m_filteredOrientation;
+	float m_filteredLinearSpeed;
+	float m_filteredAngularSpeed;
+
+	double m_lastPositionLagSeconds;
+	double m_lastRotationLagSeconds;
+	double m_positionLagSumSeconds;
+	double m_rotationLagSumSeconds;
+	int m_filteredSampleCount;
+};
+
+// Decides when a controller is lying still, so that its pose can be frozen and published at a reduced rate.
+// The controller counts as stationary once its speeds and its drift from an anchor pose have stayed
+// under their thresholds for the settle time, and stops being stationary on the first sample that doesn't.
+class CPSMoveStationaryDetector
+{
+public:
+	CPSMoveStationaryDetector();
+
+	void SetParameters(float linearSpeedThreshold, float angularSpeedThreshold, float positionTolerance, float angleTolerance, float settleTimeSeconds);
+	inline void SetEnabled(bool bEnabled) { m_bEnabled = bEnabled; Reset(); }
+	inline bool IsEnabled() const { return m_bEnabled; }
+	void Reset();
+
+	// Position in meters, speeds in m/s and rad/s, time in seconds. Returns true while stationary.
+	bool Update(double timeSeconds, const PSMVector3f &position, const PSMQuatf &orientation, float linearSpeed, float angularSpeed);
+	inline bool IsStationary() const { return m_bIsStationary; }
+	inline unsigned long long GetStationaryEntryCount() const { return m_nStationaryEntryCount; }
+
+private:
+	bool m_bEnabled;
+	float m_linearSpeedThreshold;
+	float m_angularSpeedThreshold;
+	float m_positionTolerance;
+	float m_angleTolerance;
+	float m_settleTimeSeconds;
+
+	bool m_bHasAnchor;
+	bool m_bIsStationary;
+	double m_anchorTimeSeconds;
+	PSMVector3f m_anchorPosition;
+	PSMQuatf m_anchorOrientation;
+	unsigned long long m_nStationaryEntryCount;
+};
+
+class CPSMoveAxisEventFilter
+{
+public:
+	CPSMoveAxisEventFilter();
+
+	// quantizationSteps: steps per unit of axis travel (0 = off)
+	// deadband: minimum change from the last sent value (in axis units)
+	// maxEventRateHz: per axis cap on the event rate (0 = unlimited)
+	void SetParameters(int quantizationSteps, float deadband, float maxEventRateHz);
+	void Reset();
+
+	// Quantizes the axis in place and returns true if an axis event should be sent for it.
+	// A suppressed change is reverted to the last sent value, so the polled state never
+	// gets ahead of the events. Exact rest (0) and end stop (+-1) values are never suppressed.
+	bool FilterAxis(uint32_t axisIndex, vr::VRControllerAxis_t &axis, double timeSeconds);
+
+	inline unsigned long long GetSentEventCount() const { return m_nSentEventCount; }
+	inline unsigned long long GetDeadbandSuppressedCount() const { return m_nDeadbandSuppressedCount; }
+	inline unsigned long long GetRateSuppressedCount() const { return m_nRateSuppressedCount; }
+
+private:
+	float m_quantizationSteps;
+	float m_deadband;
+	double m_minEventIntervalSeconds;
+
+	vr::VRControllerAxis_t m_lastSentAxis[vr::k_unControllerStateAxisCount];
+	double m_lastSentTimeSeconds[vr::k_unControllerStateAxisCount];
+
+	unsigned long long m_nSentEventCount;
+	unsigned long long m_nDeadbandSuppressedCount;
+	unsigned long long m_nRateSuppressedCount;
+};
+
+class CPSMoveAnalogStage
+{
+public:
+	static const int k_responseCurveSegments = 256;
+	static const int k_maxTriggers = 2;
+
+	CPSMoveAnalogStage();
+
+	// Deadzones are fractions of full travel. The response curve is output = input^exponent
+	// (1 = linear, >1 = finer control near rest), sampled once into a lookup table.
+	void SetStickParameters(float deadzoneRadius, float curveExponent);
+	// Touch/press thresholds apply to the shaped trigger value. Each state turns on above 
+	// its threshold and only turns off again once the value drops hysteresis below it.
+	void SetTriggerParameters(float deadzone, float curveExponent, float touchThreshold, float pressThreshold, float hysteresis);
+	void Reset();
+
+	// Applies the radial deadzone and response curve to the stick in place.
+	// Returns false (and zeroes the stick) while it is inside the deadzone.
+	bool ProcessStick(float &x, float &y) const;
+	// Returns the shaped trigger value and updates the trigger's touch/press state
+	float ProcessTrigger(int triggerIndex, float value);
+	inline bool IsTriggerTouched(int triggerIndex) const { return m_bTriggerTouched[triggerIndex]; }
+	inline bool IsTriggerPressed(int triggerIndex) const { return m_bTriggerPressed[triggerIndex]; }
+
+private:
+	static void BuildResponseCurve(float exponent, float *curve);
+	static float EvaluateResponseCurve(const float *curve, float value);
+
+	float m_stickDeadzone;
+	float m_stickResponseCurve[k_responseCurveSegments + 1];
+
+	float m_triggerDeadzone;
+	float m_triggerResponseCurve[k_responseCurveSegments + 1];
+	float m_triggerTouchThreshold;
+	float m_triggerPressThreshold;
+	float m_triggerHysteresis;
+	bool m_bTriggerTouched[k_maxTriggers];
+	bool m_bTriggerPressed[k_maxTriggers];
+};
+
+class CPSMoveGestureEngine
+{
+public:
+	// When several gestures complete in the same update the highest action wins
+	enum eGestureAction
+	{
+		k_EGestureAction_None,
+		k_EGestureAction_RecenterController,
+		k_EGestureAction_RealignHMD,
+
+		k_EGestureAction_Count
+	};
+
+	enum eGestureRequirement
+	{
+		k_EGestureRequirement_Always,
+		k_EGestureRequirement_NoChildController,
+		k_EGestureRequirement_ChildController,
+	};
+
+	struct GestureButton
+	{
+		uint16_t stateOffset; // byte offset of the PSMButtonState within PSMController::ControllerState
+		bool bIsChildButton;
+	};
+
+	static const int k_maxGestures = 8;
+	static const int k_maxGestureButtons = 4;
+
+	CPSMoveGestureEngine();
+
+	void Clear();
+	// A gesture completes once all of its buttons have been held together for holdSeconds 
+	// (0 = a chord, completing as soon as the last button goes down). It fires once, then 
+	// waits for one of its buttons to be released.
+	bool AddGesture(eGestureAction action, eGestureRequirement requirement, const GestureButton *buttons, int buttonCount, float holdSeconds);
+	inline int GetGestureCount() const { return m_gestureCount; }
+
+	// Advances every gesture with this update's button states. childView is null without a child controller.
+	eGestureAction Update(const PSMController *view, const PSMController *childView, double timeSeconds);
+
+	inline unsigned long long GetFiredCount(eGestureAction action) const { return m_nFiredCount[action]; }
+
+private:
+	struct Gesture
+	{
+		eGestureAction action;
+		eGestureRequirement requirement;
+		GestureButton buttons[k_maxGestureButtons];
+		int buttonCount;
+		double holdSeconds;
+
+		bool bIsHeld;
+		bool bHasFired;
+		double heldSinceSeconds;
+	};
+
+	Gesture m_gestures[k_maxGestures];
+	int m_gestureCount;
+	unsigned long long m_nFiredCount[k_EGestureAction_Count];
+};
+
+class CPSMoveControllerLatest final : public CPSMoveTrackedDeviceLatest, public vr::IVRControllerComponent
 {
 public:
 	// Mirrors definition in PSMControllerType
@@ -213,6 +575,7 @@ public:
     virtual vr::EVRInitError Activate(vr::TrackedDeviceIndex_t unObjectId) override;
     virtual void Deactivate() override;
     virtual void *GetComponent(const char *pchComponentNameAndVersion) override;
+    virtual void DebugRequest(const char * pchRequest, char * pchResponseBuffer, uint32_t unResponseBufferSize) override;
 
     // Implementation of vr::IVRControllerComponent
     virtual vr::VRControllerState_t GetControllerState() override;
@@ -225,8 +588,19 @@ public:
 
 	// CPSMoveControllerLatest Interface 
     bool HasControllerId(int ControllerID);
-	bool AttachChildPSMController(int ChildControllerId, PSMControllerType controllerType, const std::string &ChildControllerSerialNo);
+	bool AttachChildPSMController(int ChildControllerId, PSMControllerType controllerType, const char *ChildControllerSerialNo);
+	void ReleasePSMController();
+	void AcquirePSMController(int ControllerID);
+	void PublishDisconnectedPose();
+	void EnterReconnectingState();
+	void StartControllerDataStream();
+	inline bool IsListedByService() const { return m_bIsListedByService; }
+	inline bool IsReconnecting() const { return m_bIsReconnecting; }
+	bool GatherLatestPose(const std::chrono::time_point<std::chrono::high_resolution_clock> &now);
+	void FilterLatestPose(const std::chrono::time_point<std::chrono::high_resolution_clock> &now);
+	void PublishLatestPose();
     inline bool HasPSMControllerId(int ControllerID) const { return ControllerID == m_nPSMControllerId; }
+	inline int getPSMControllerId() const { return m_nPSMControllerId; }
 	inline const PSMController * getPSMControllerView() const { return m_PSMControllerView; }
 	inline std::string getPSMControllerSerialNo() const { return m_strPSMControllerSerialNo; }
 	inline PSMControllerType getPSMControllerType() const { return m_PSMControllerType; }
@@ -238,11 +612,17 @@ private:
 	void StartRealignHMDTrackingSpace();
 	static void FinishRealignHMDTrackingSpace(const PSMPosef &hmd_pose_meters, void *userdata);
     void UpdateControllerState();
-	void UpdateControllerStateFromPsMoveButtonState(ePSControllerType controllerType, ePSButtonID buttonId, PSMButtonState buttonState, vr::VRControllerState_t* pControllerStateToUpdate);
+	void CompileInputMappings();
+	void AddInputMapping(ePSControllerType controllerType, ePSButtonID buttonId, bool bIsChildButton, size_t stateOffset);
+	void ApplyInputMappings(bool bHasChildController, vr::VRControllerState_t* pControllerStateToUpdate);
 	void GetMetersPosInRotSpace(const PSMQuatf *rotation, PSMVector3f* outPosition);
-    void UpdateTrackingState();
+	double ComputeSampleAgeSeconds(const std::chrono::time_point<std::chrono::high_resolution_clock> &now) const;
+	void PublishFrozenPose(const std::chrono::time_point<std::chrono::high_resolution_clock> &now);
+	void SetDriverPoseVelocities(const PSMVector3f &linearVelocity, const PSMVector3f &angularVelocity);
     void UpdateRumbleState();
 	void UpdateBatteryChargeState(PSMBatteryState newBatteryEnum);
+	void SendAxisUpdate(uint32_t axisIndex, vr::VRControllerState_t &newState, double timeSeconds);
+	void StopControllerDataStream();
 
     // Controller State
     int m_nPSMControllerId;
@@ -250,6 +630,17 @@ private:
     PSMController *m_PSMControllerView;
 	std::string m_strPSMControllerSerialNo;
 
+	// False while the controller is missing from the service's controller list.
+	// The device keeps its SteamVR slot (identified by serial) but reports itself disconnected.
+	bool m_bIsListedByService;
+
+	// True from losing the service connection until the controller is either
+	// listed again (and its stream resumed) or found to be gone
+	bool m_bIsReconnecting;
+
+	// The data stream is started as soon as the controller is known, not when vrserver activates it
+	bool m_bIsDataStreamStarted;
+
     // Child Controller State
     int m_nPSMChildControllerId;
 	PSMControllerType m_PSMChildControllerType;
@@ -262,6 +653,13 @@ private:
     // Used to ignore old state from PSM Service
     int m_nPoseSequenceNumber;
 
+	// Sequence number of the last pose sent to vrserver by PublishLatestPose() 
+	// (may be ahead of m_nPoseSequenceNumber when the pose publisher thread is active)
+	int m_nPublishedPoseSequenceNumber;
+
+	// When the driver first saw the current sample (fallback for the sample age)
+	std::chrono::time_point<std::chrono::high_resolution_clock> m_lastNewSampleTime;
+
     // To main structures for passing state to vrserver
     vr::VRControllerState_t m_ControllerState;
 
@@ -275,9 +673,11 @@ private:
     std::chrono::time_point<std::chrono::high_resolution_clock> m_lastTimeRumbleSent;
     bool m_lastTimeRumbleSentValid;
 
-	//virtual extend controller in meters
-	float m_fVirtuallExtendControllersYMeters;
-	float m_fVirtuallExtendControllersZMeters;
+	// Transform from the controller's tracked frame to the frame reported to vrserver
+	// (grip/tip point, prop mounts, etc). Composed once when the settings are loaded
+	// and handed to vrserver as the pose's driver-from-head transform.
+	vr::HmdQuaternion_t m_qLocalOffsetRotation;
+	double m_vecLocalOffsetTranslation[3];
 
 	// delay in resetting touchpad position after touchpad press
 	bool m_bDelayAfterTouchpadPress;
@@ -289,10 +689,8 @@ private:
 	std::chrono::time_point<std::chrono::high_resolution_clock> m_lastTouchpadPressTime;
 	bool m_touchpadDirectionsUsed;
 
-	std::chrono::time_point<std::chrono::high_resolution_clock> m_resetPoseButtonPressTime;
-	bool m_bResetPoseRequestSent;
-	std::chrono::time_point<std::chrono::high_resolution_clock> m_resetAlignButtonPressTime;
-	bool m_bResetAlignRequestSent;
+	// Recenter/realign chords and long presses
+	CPSMoveGestureEngine m_gestureEngine;
 
 	bool m_bUsePSNaviDPadRecenter;
 	bool m_bUsePSNaviDPadRealign;
@@ -300,6 +698,32 @@ private:
     // Button Remapping
     vr::EVRButtonId psButtonIDToVRButtonID[k_EPSControllerType_Count][k_EPSButtonID_Count];
 	eVRTouchpadDirection psButtonIDToVrTouchpadDirection[k_EPSControllerType_Count][k_EPSButtonID_Count];
+
+	// The button mappings above compiled into a flat list once the settings are loaded.
+	// Each entry reads one PSMButtonState from the controller (or child controller) state 
+	// and, if any bit of stateMask is set, or's in its button masks and drives the touchpad axis.
+	enum eInputMappingAxis
+	{
+		k_EInputMappingAxis_X = 0x01,
+		k_EInputMappingAxis_Y = 0x02
+	};
+
+	struct InputMappingEntry
+	{
+		uint16_t stateOffset; // byte offset of the PSMButtonState within PSMController::ControllerState
+		bool bIsChildButton;
+		uint8_t stateMask;
+		uint8_t touchpadAxisMask; // eInputMappingAxis flags, non-zero for touchpad direction mappings
+		uint64_t pressedMask;
+		uint64_t touchedMask;
+		float touchpadX;
+		float touchpadY;
+	};
+
+	static const int k_maxInputMappings = 2 * k_EPSButtonID_Count;
+	InputMappingEntry m_inputMappings[k_maxInputMappings];
+	int m_inputMappingCount;
+
     void LoadButtonMapping(
         vr::IVRSettings *pSettings,
 		const CPSMoveControllerLatest::ePSControllerType controllerType,
@@ -310,6 +734,13 @@ private:
 	bool LoadBool(vr::IVRSettings *pSettings, const char *pchSection, const char *pchSettingsKey, const bool bDefaultValue);
 	int LoadInt(vr::IVRSettings *pSettings, const char *pchSection, const char *pchSettingsKey, const int iDefaultValue);
 	float LoadFloat(vr::IVRSettings *pSettings, const char *pchSection, const char *pchSettingsKey, const float fDefaultValue);
+	void LoadJitterFilterSettings(vr::IVRSettings *pSettings, const char *pchSection);
+	void LoadStationaryDetectionSettings(vr::IVRSettings *pSettings, const char *pchSection);
+	void LoadGestureSettings(vr::IVRSettings *pSettings);
+	void LoadGestureBinding(vr::IVRSettings *pSettings, const char *pchSection, const char *pchSettingsKey, const char *pchDefaultBinding, CPSMoveGestureEngine::eGestureAction action, CPSMoveGestureEngine::eGestureRequirement requirement);
+	void LoadAnalogStageSettings(vr::IVRSettings *pSettings, const char *pchStickSection, const char *pchTriggerSection);
+	void LoadAxisEventFilterSettings(vr::IVRSettings *pSettings, const char *pchSection, int defaultQuantizationSteps, float defaultDeadband);
+	void LoadLocalOffsetSettings(vr::IVRSettings *pSettings, const PSMVector3f &defaultTranslationMeters);
 
 	// Settings values. Used to determine whether we'll map controller movement after touchpad
 	// presses to touchpad axis values.
@@ -334,17 +765,44 @@ private:
 	// The axis to use for trigger input
 	int m_triggerAxisIndex;
 
-	// The size of the deadzone for the controller's thumbstick
-	float m_thumbstickDeadzone;
+	// Deadzones, response curves and trigger thresholds for the thumbsticks and triggers
+	CPSMoveAnalogStage m_analogStage;
 
 	// Treat a thumbstick touch also as a press
 	bool m_bThumbstickTouchAsPress;
 
+	// How far into the future (in seconds) the driver extrapolates each pose 
+	// using the controller's physics state. Zero disables driver side prediction.
+	float m_fPosePredictionSeconds;
+
+	// Recent raw (unfiltered) poses, shared by velocity estimation and diagnostics
+	CPSMovePoseHistory m_poseHistory;
+
+	// Velocity reconstruction from the pose history (DS4 only)
+	CPSMoveVelocityEstimator m_velocityEstimator;
+
+	// Adaptive smoothing of the optical pose, applied before prediction
+	CPSMovePoseJitterFilter m_poseJitterFilter;
+
+	// While the controller is lying still the last published pose is frozen
+	// and only re-sent at the heartbeat rate
+	CPSMoveStationaryDetector m_stationaryDetector;
+	std::chrono::time_point<std::chrono::high_resolution_clock> m_lastFrozenPosePublishTime;
+	float m_fStationaryHeartbeatMilliseconds;
+	unsigned long long m_nStationarySkippedPoseCount;
+
+	// Drops axis events for changes too small (or too frequent) to matter
+	CPSMoveAxisEventFilter m_axisEventFilter;
+
+	// Button event counters (reported by the psmove:button_stats debug request)
+	unsigned long long m_nButtonChangeFrameCount;
+	unsigned long long m_nButtonEventCount;
+
     // Callbacks
     static void start_controller_response_callback(const PSMResponseMessage *response, void *userdata);
 };
 
-class CPSMoveTrackerLatest : public CPSMoveTrackedDeviceLatest
+class CPSMoveTrackerLatest final : public CPSMoveTrackedDeviceLatest
 {
 public:
     CPSMoveTrackerLatest(const PSMClientTrackerInfo *trackerInfo);
@@ -353,13 +811,19 @@ public:
     // Overridden Implementation of vr::ITrackedDeviceServerDriver
     virtual vr::EVRInitError Activate(vr::TrackedDeviceIndex_t unObjectId) override;
     virtual void Deactivate() override;
+    virtual void DebugRequest(const char * pchRequest, char * pchResponseBuffer, uint32_t unResponseBufferSize) override;
 
     // Overridden Implementation of CPSMoveTrackedDeviceLatest
     virtual vr::ETrackedDeviceClass GetTrackedDeviceClass() const override { return vr::TrackedDeviceClass_TrackingReference; }
     virtual void Update() override;
+	virtual void RefreshWorldFromDriverPose() override;
 
     bool HasTrackerId(int ControllerID);
+	inline int GetTrackerId() const { return m_nTrackerId; }
     void SetClientTrackerInfo(const PSMClientTrackerInfo *trackerInfo);
+	void SetRemovedFromService();
+	void EnterReconnectingState();
+	inline bool IsListedByService() const { return m_Pose.deviceIsConnected; }
 
 private:
     // Which tracker
@@ -367,4 +831,155 @@ private:
 
     // The static information about this tracker
     PSMClientTrackerInfo m_tracker_info;
+
+	// The tracker pose only changes when the tracker info or the world-from-driver transform does,
+	// so it's only sent to vrserver then (plus an occasional heartbeat)
+	bool m_bPoseDirty;
+	std::chrono::time_point<std::chrono::high_resolution_clock> m_lastPosePublishTime;
+	unsigned long long m_nPosePublishCount;
+	unsigned long long m_nPosePublishSkipCount;
+};
+
+class CServerDriver_PSMoveService : public vr::IServerTrackedDeviceProvider
+{
+public:
+    CServerDriver_PSMoveService();
+    virtual ~CServerDriver_PSMoveService();
+
+    // Inherited via IServerTrackedDeviceProvider
+    virtual vr::EVRInitError Init( vr::IVRDriverContext *pDriverContext ) override;
+    virtual void Cleanup() override;
+    virtual const char * const *GetInterfaceVersions() override;
+    virtual void RunFrame() override;
+    virtual bool ShouldBlockStandbyMode() override;
+    virtual void EnterStandby() override;
+    virtual void LeaveStandby() override;
+
+    void LaunchPSMoveMonitor();
+
+	void SetHMDTrackingSpace(const PSMPosef &origin_pose);
+    inline PSMPosef GetWorldFromDriverPose() const { return m_worldFromDriverPose; }
+	inline bool IsPosePublisherThreadActive() const { return m_pPosePublisherThread != nullptr; }
+	inline std::recursive_mutex &GetPSMClientMutex() { return m_psmClientMutex; }
+	// Provider wide stats (connection, message, dispatch, device_update, pose_publish), all sections when strSection is empty
+	void GetProviderStats(const std::string &strSection, char *pchResponseBuffer, uint32_t unResponseBufferSize);
+
+private:
+	void GetPosePublishStats(char *pchResponseBuffer, uint32_t unResponseBufferSize);
+	void GetConnectionStats(char *pchResponseBuffer, uint32_t unResponseBufferSize);
+	void GetMessageStats(char *pchResponseBuffer, uint32_t unResponseBufferSize);
+	void GetDispatchStats(char *pchResponseBuffer, uint32_t unResponseBufferSize);
+	void GetDeviceUpdateStats(char *pchResponseBuffer, uint32_t unResponseBufferSize);
+    vr::ITrackedDeviceServerDriver * FindTrackedDeviceDriver(const char * pchId);
+    void AllocateUniquePSMoveController(PSMControllerID ControllerID, const char *ControllerSerial);
+    void AttachPSNaviToParentController(PSMControllerID ControllerID, const char *ControllerSerial, const char *ParentControllerSerial);
+    void AllocateUniqueDualShock4Controller(PSMControllerID ControllerID, const char *ControllerSerial);
+    void AllocateUniquePSMoveTracker(const PSMClientTrackerInfo *trackerInfo);
+    bool ReconnectToPSMoveService();
+	void ScheduleReconnectToPSMoveService();
+
+    // Event Handling
+	void RegisterMessageHandlers();
+	void PollQueuedMessages();
+	void IssueQueuedListRequests();
+    void HandleConnectedToPSMoveService();
+    void HandleFailedToConnectToPSMoveService();
+    void HandleDisconnectedFromPSMoveService();
+	static void HandleServiceVersionResponse(const PSMResponseMessage *response, void *userdata);
+    void HandleControllerListChanged();
+    void HandleTrackerListChanged();
+
+    // Response Handling
+	void HandleControllerListMessage(const PSMResponseMessage *response);
+	void HandleTrackerListMessage(const PSMResponseMessage *response);
+    void HandleControllerListReponse(const PSMControllerList *controller_list, const PSMResponseHandle response_handle);
+    void HandleTrackerListReponse(const PSMTrackerList *tracker_list);
+	void FlushPendingDeviceLists();
+	void DiscardPendingDeviceLists();
+    
+    void LaunchPSMoveMonitor_Internal( const char * pchDriverInstallDir );
+
+	// Pose Publisher Thread
+	void StartPosePublisherThread();
+	void StopPosePublisherThread();
+	void PosePublisherThreadFunction();
+
+	// Pose Publishing
+	void PublishControllerPoses();
+
+	std::string m_strPSMoveHMDSerialNo;
+	std::string m_strPSMoveServiceAddress;
+	std::string m_strServerPort;
+
+    bool m_bLaunchedPSMoveMonitor;
+	bool m_bInitialized;
+
+	// Controllers and trackers are kept in separate collections so they can be updated in tight, 
+	// non-virtual loops. A deque never moves its elements, so the device pointers handed out to
+	// vrserver (and kept in the registry) stay valid as devices get added.
+	std::deque<CPSMoveControllerLatest> m_controllers;
+	std::deque<CPSMoveTrackerLatest> m_trackers;
+	CPSMoveTrackedDeviceRegistry m_deviceRegistry;
+
+    // HMD Tracking Space
+    PSMPosef m_worldFromDriverPose;
+
+	// Optional thread that publishes controller poses as soon as new samples arrive,
+	// rather than waiting for the next RunFrame() from vrserver.
+	// The PSM client API isn't thread safe, so all access to it (and the tracked device list)
+	// is serialized through m_psmClientMutex while the publisher thread is running.
+	// The device entry points vrserver calls (Activate, Deactivate, DebugRequest, ...) lock it too.
+	bool m_bUsePosePublisherThread;
+	int m_posePublisherPollIntervalMicroseconds;
+	std::atomic_bool m_bPosePublisherExitSignaled;
+	std::thread *m_pPosePublisherThread;
+	std::recursive_mutex m_psmClientMutex;
+
+	// Paces reconnect attempts while the service is unreachable.
+	// Only a single service is supported: the PSM client API is a process-wide singleton,
+	// so streaming from several services at once would need a client context per service.
+	CPSMoveReconnectScheduler m_reconnectScheduler;
+
+	// The controller and tracker lists are requested alongside the service version,
+	// but aren't acted on until the version has been verified
+	enum eServiceVersionState
+	{
+		k_EServiceVersionState_Pending,
+		k_EServiceVersionState_Verified,
+		k_EServiceVersionState_Failed
+	};
+	eServiceVersionState m_serviceVersionState;
+	std::atomic_bool m_bShutdownRequested;
+	PSMControllerList m_pendingControllerList;
+	PSMTrackerList m_pendingTrackerList;
+	bool m_bHasPendingControllerList;
+	bool m_bHasPendingTrackerList;
+
+	// Responses and events are handled after the poses went out, within a per-frame time budget.
+	// Whatever doesn't fit stays queued in the client API for the next frame.
+	// List changed events only queue up a refresh, so a burst of them costs a single request.
+	int m_messagePollBudgetMicroseconds;
+	bool m_bControllerListRefreshQueued;
+	bool m_bTrackerListRefreshQueued;
+	unsigned long long m_nMessagePollFrameCount;
+	unsigned long long m_nMessagesHandledCount;
+	unsigned long long m_nMessageBudgetExceededCount;
+	unsigned long long m_nCoalescedListRefreshCount;
+	int m_nMaxMessagesPerFrame;
+	CPSMoveMessageDispatcher m_messageDispatcher;
+
+	// Cost of the per-frame device update loops
+	unsigned long long m_nDeviceUpdateFrameCount;
+	double m_deviceUpdateTotalSeconds;
+	double m_deviceUpdateMaxSeconds;
+
+	// Cost of converting and publishing the controller poses, per pose
+	unsigned long long m_nPublishedPoseCount;
+	double m_posePublishTotalSeconds;
+
+	// Devices stay registered with vrserver across a service restart,
+	// this measures how long the controllers went without a pose
+	std::chrono::time_point<std::chrono::high_resolution_clock> m_serviceDisconnectTime;
+	bool m_bAwaitingFirstPoseAfterResume;
+	double m_lastResumeTimeToFirstPoseSeconds;
 };
\ No newline at end of file